@@ -0,0 +1,112 @@
+#include "big_fixed.h"
+
+#include <algorithm>
+#include <cmath>
+
+static bool is_negative(const BigFixed &a)
+{
+    return a.limbs.back() >> 31;
+}
+
+static BigFixed negate(const BigFixed &a)
+{
+    BigFixed r{std::vector<uint32_t>(a.limbs.size())};
+    uint64_t carry = 1;
+    for (size_t i = 0; i < a.limbs.size(); i++)
+    {
+        uint64_t v = uint64_t(~a.limbs[i]) + carry;
+        r.limbs[i] = uint32_t(v);
+        carry = v >> 32;
+    }
+    return r;
+}
+
+int big_fixed_fraction_limbs(double step)
+{
+    // bits below the binary point down to the pixel step, plus 64 guard bits
+    int bits = int(std::ceil(-std::log2(step))) + 64;
+    return std::max(2, (bits + 31) / 32);
+}
+
+BigFixed big_fixed(double value, int fraction_limbs)
+{
+    BigFixed r{std::vector<uint32_t>(fraction_limbs + 1)};
+    double magnitude = std::fabs(value);
+    double whole = std::floor(magnitude);
+    r.limbs[fraction_limbs] = uint32_t(whole);
+
+    // peel off 32 bits at a time, every step is exact in double
+    double fraction = magnitude - whole;
+    for (int i = fraction_limbs - 1; i >= 0 && fraction != 0.0; i--)
+    {
+        fraction = std::ldexp(fraction, 32);
+        double digit = std::floor(fraction);
+        r.limbs[i] = uint32_t(digit);
+        fraction -= digit;
+    }
+    return value < 0 ? negate(r) : r;
+}
+
+BigFixed big_fixed(const DoubleDouble &value, int fraction_limbs)
+{
+    return big_fixed(value.hi, fraction_limbs) + big_fixed(value.lo, fraction_limbs);
+}
+
+double to_double(const BigFixed &value)
+{
+    bool negative = is_negative(value);
+    const BigFixed &magnitude = negative ? negate(value) : value;
+    // the top three limbs hold more than a double's worth of bits
+    size_t n = magnitude.limbs.size();
+    double v = 0.0;
+    for (size_t i = n > 3 ? n - 3 : 0; i < n; i++)
+    {
+        v = std::ldexp(v, -32) + double(magnitude.limbs[i]);
+    }
+    return negative ? -v : v;
+}
+
+BigFixed operator+(const BigFixed &a, const BigFixed &b)
+{
+    BigFixed r{std::vector<uint32_t>(a.limbs.size())};
+    uint64_t carry = 0;
+    for (size_t i = 0; i < a.limbs.size(); i++)
+    {
+        uint64_t v = uint64_t(a.limbs[i]) + b.limbs[i] + carry;
+        r.limbs[i] = uint32_t(v);
+        carry = v >> 32;
+    }
+    return r;
+}
+
+BigFixed operator-(const BigFixed &a, const BigFixed &b)
+{
+    return a + negate(b);
+}
+
+BigFixed operator*(const BigFixed &a, const BigFixed &b)
+{
+    bool negative = is_negative(a) != is_negative(b);
+    BigFixed ua = is_negative(a) ? negate(a) : a;
+    BigFixed ub = is_negative(b) ? negate(b) : b;
+
+    // schoolbook product of the magnitudes, 2n limbs with twice the fraction
+    size_t n = a.limbs.size();
+    std::vector<uint32_t> product(2 * n, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < n; j++)
+        {
+            uint64_t t = uint64_t(ua.limbs[i]) * ub.limbs[j] + product[i + j] + carry;
+            product[i + j] = uint32_t(t);
+            carry = t >> 32;
+        }
+        product[i + n] = uint32_t(carry);
+    }
+
+    // drop the extra fraction limbs
+    size_t fraction = n - 1;
+    BigFixed r{std::vector<uint32_t>(product.begin() + fraction, product.begin() + fraction + n)};
+    return negative ? negate(r) : r;
+}
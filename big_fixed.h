@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "double_double.h"
+
+// Arbitrary precision fixed-point number for the perturbation reference
+// orbit. Two's complement over 32-bit limbs, least significant first: the
+// last limb is the signed integer part, the ones below it are the fraction.
+// Every operand of an operation has to have the same number of limbs.
+//
+// The integer part limits values to +-2^31, plenty for an orbit that is
+// stopped at the escape radius.
+struct BigFixed
+{
+    std::vector<uint32_t> limbs;
+};
+
+// Fractional limbs needed to resolve pixels step apart, plus headroom for
+// the error growth along the orbit.
+int big_fixed_fraction_limbs(double step);
+
+// Exact conversions, as long as the value fits the fraction limbs
+BigFixed big_fixed(double value, int fraction_limbs);
+BigFixed big_fixed(const DoubleDouble &value, int fraction_limbs);
+// nearest double, give or take the last bit
+double to_double(const BigFixed &value);
+
+BigFixed operator+(const BigFixed &a, const BigFixed &b);
+BigFixed operator-(const BigFixed &a, const BigFixed &b);
+// truncated to the precision of the operands
+BigFixed operator*(const BigFixed &a, const BigFixed &b);
@@ -0,0 +1,174 @@
+#include "boundary_trace.h"
+
+#include <vector>
+
+// the trace through one tile: which pixels are computed, and the ones
+// queued for it, on the thread rendering it
+template <typename Count>
+struct BoundaryTrace
+{
+    int x0, y0, tile_width, tile_height;
+    int width;
+    Count *bitmap;
+    Count *period;
+    const ComputePixels &compute;
+    TileStats stats;
+    // per tile pixel, row-major from (x0, y0)
+    std::vector<bool> computed;
+    std::vector<bool> queued;
+    std::vector<int> pending;
+    std::vector<int> queue;
+
+    int pixel(int t) const { return width * (y0 + t / tile_width) + x0 + t % tile_width; }
+
+    bool same(int a, int b) const
+    {
+        int pa = pixel(a), pb = pixel(b);
+        return bitmap[pa] == bitmap[pb] && period[pa] == period[pb];
+    }
+
+    void need(int t)
+    {
+        if (!computed[t])
+        {
+            computed[t] = true;
+            pending.push_back(pixel(t));
+        }
+    }
+
+    void add(int t, std::vector<int> &next)
+    {
+        if (!queued[t])
+        {
+            queued[t] = true;
+            next.push_back(t);
+        }
+    }
+
+    // Queues the neighbours across every edge of t with a change, and the
+    // diagonal ones next to such an edge
+    void scan(int t, std::vector<int> &next)
+    {
+        int x = t % tile_width, y = t / tile_width;
+        bool has_l = x > 0, has_r = x < tile_width - 1;
+        bool has_u = y > 0, has_d = y < tile_height - 1;
+        bool l = has_l && !same(t, t - 1);
+        bool r = has_r && !same(t, t + 1);
+        bool u = has_u && !same(t, t - tile_width);
+        bool d = has_d && !same(t, t + tile_width);
+        if (l)
+        {
+            add(t - 1, next);
+        }
+        if (r)
+        {
+            add(t + 1, next);
+        }
+        if (u)
+        {
+            add(t - tile_width, next);
+        }
+        if (d)
+        {
+            add(t + tile_width, next);
+        }
+        if (has_u && has_l && (l || u))
+        {
+            add(t - tile_width - 1, next);
+        }
+        if (has_u && has_r && (r || u))
+        {
+            add(t - tile_width + 1, next);
+        }
+        if (has_d && has_l && (l || d))
+        {
+            add(t + tile_width - 1, next);
+        }
+        if (has_d && has_r && (r || d))
+        {
+            add(t + tile_width + 1, next);
+        }
+    }
+
+    void run()
+    {
+        int n = tile_width * tile_height;
+        computed.assign(n, false);
+        queued.assign(n, false);
+        for (int t = 0; t < n; t++)
+        {
+            int x = t % tile_width, y = t / tile_width;
+            if (x == 0 || y == 0 || x == tile_width - 1 || y == tile_height - 1)
+            {
+                add(t, queue);
+            }
+        }
+
+        // In waves, so the kernels get a batch of pixels at a time: the
+        // queued pixels and their neighbours are computed, then scanned. The
+        // pixels queued come out the same as scanning one at a time.
+        std::vector<int> next;
+        while (!queue.empty())
+        {
+            for (int t : queue)
+            {
+                int x = t % tile_width, y = t / tile_width;
+                need(t);
+                if (x > 0)
+                {
+                    need(t - 1);
+                }
+                if (x < tile_width - 1)
+                {
+                    need(t + 1);
+                }
+                if (y > 0)
+                {
+                    need(t - tile_width);
+                }
+                if (y < tile_height - 1)
+                {
+                    need(t + tile_width);
+                }
+            }
+            if (!pending.empty())
+            {
+                compute(pending.data(), int(pending.size()));
+                stats.computed += pending.size();
+                pending.clear();
+            }
+
+            next.clear();
+            for (int t : queue)
+            {
+                scan(t, next);
+            }
+            queue.swap(next);
+        }
+
+        // the rest is enclosed by traced pixels of one value; the left
+        // neighbour is done already, the first column being border
+        for (int t = 0; t < n; t++)
+        {
+            if (!computed[t])
+            {
+                bitmap[pixel(t)] = bitmap[pixel(t - 1)];
+                period[pixel(t)] = period[pixel(t - 1)];
+                stats.filled++;
+            }
+        }
+    }
+};
+
+template <typename Count>
+TileStats trace_tile(int x0, int y0, int x1, int y1, int width, Count *bitmap, Count *period, const ComputePixels &compute)
+{
+    BoundaryTrace<Count> trace{x0, y0, x1 - x0 + 1, y1 - y0 + 1, width, bitmap, period, compute, {}, {}, {}, {}, {}};
+    trace.run();
+    return trace.stats;
+}
+
+// tracing over buffers of every count type
+template TileStats trace_tile(int, int, int, int, int, uint8_t *, uint8_t *, const ComputePixels &);
+template TileStats trace_tile(int, int, int, int, int, uint16_t *, uint16_t *, const ComputePixels &);
+template TileStats trace_tile(int, int, int, int, int, uint32_t *, uint32_t *, const ComputePixels &);
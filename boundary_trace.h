@@ -0,0 +1,15 @@
+#pragma once
+
+#include "subdivision.h"
+
+// Boundary tracing. Starting from the tile border, only pixels next to a
+// change of count (or period) are followed, tracing the edges of the regions
+// of one value; whatever is left is inside such a region and is filled from
+// its left neighbour. Work grows with the length of the boundaries rather
+// than the number of pixels.
+//
+// Each tile computes its own border and traces only inside itself, so tiles
+// can run on different threads and meet exactly at the seams. Count is as in
+// subdivide_tile().
+template <typename Count>
+TileStats trace_tile(int x0, int y0, int x1, int y1, int width, Count *bitmap, Count *period, const ComputePixels &compute);
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "hip/hip_runtime.h"
+
+// Unevaluated sum of two doubles, hi + lo with |lo| <= ulp(hi) / 2, giving
+// about 106 bits of mantissa. Enough for zooms to around 1e30 at a small
+// multiple of the cost of double, and usable as the Real of escape_time().
+//
+// The algorithms are the usual error-free transformations (Dekker, Knuth);
+// they rely on every operation being rounded on its own, which is why the
+// build passes -ffp-contract=off.
+struct DoubleDouble
+{
+    double hi = 0.0;
+    double lo = 0.0;
+
+    DoubleDouble() = default;
+    __host__ __device__ DoubleDouble(double value) : hi(value), lo(0.0) {}
+    __host__ __device__ DoubleDouble(double hi, double lo) : hi(hi), lo(lo) {}
+
+    __host__ __device__ explicit operator double() const { return hi + lo; }
+    __host__ __device__ explicit operator float() const { return float(hi + lo); }
+};
+
+namespace dd_detail
+{
+// a + b exactly, for |a| >= |b|
+__host__ __device__ inline DoubleDouble quick_two_sum(double a, double b)
+{
+    double s = a + b;
+    return {s, b - (s - a)};
+}
+
+// a + b exactly
+__host__ __device__ inline DoubleDouble two_sum(double a, double b)
+{
+    double s = a + b;
+    double bb = s - a;
+    return {s, (a - (s - bb)) + (b - bb)};
+}
+
+// a * b exactly
+__host__ __device__ inline DoubleDouble two_prod(double a, double b)
+{
+    double p = a * b;
+#if defined(__HIP_DEVICE_COMPILE__)
+    return {p, fma(a, b, -p)};
+#else
+    // Dekker's split, the host build does not assume an FMA unit
+    const double SPLITTER = 134217729.0; // 2^27 + 1
+    double ta = SPLITTER * a;
+    double a_hi = ta - (ta - a);
+    double a_lo = a - a_hi;
+    double tb = SPLITTER * b;
+    double b_hi = tb - (tb - b);
+    double b_lo = b - b_hi;
+    return {p, ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo};
+#endif
+}
+} // namespace dd_detail
+
+__host__ __device__ inline DoubleDouble operator-(const DoubleDouble &a)
+{
+    return {-a.hi, -a.lo};
+}
+
+__host__ __device__ inline DoubleDouble operator+(const DoubleDouble &a, const DoubleDouble &b)
+{
+    DoubleDouble s = dd_detail::two_sum(a.hi, b.hi);
+    DoubleDouble t = dd_detail::two_sum(a.lo, b.lo);
+    s.lo += t.hi;
+    s = dd_detail::quick_two_sum(s.hi, s.lo);
+    s.lo += t.lo;
+    return dd_detail::quick_two_sum(s.hi, s.lo);
+}
+
+__host__ __device__ inline DoubleDouble operator-(const DoubleDouble &a, const DoubleDouble &b)
+{
+    return a + -b;
+}
+
+__host__ __device__ inline DoubleDouble operator*(const DoubleDouble &a, const DoubleDouble &b)
+{
+    DoubleDouble p = dd_detail::two_prod(a.hi, b.hi);
+    p.lo += a.hi * b.lo + a.lo * b.hi;
+    return dd_detail::quick_two_sum(p.hi, p.lo);
+}
+
+__host__ __device__ inline DoubleDouble operator/(const DoubleDouble &a, const DoubleDouble &b)
+{
+    // long division, one double-sized digit at a time
+    double q1 = a.hi / b.hi;
+    DoubleDouble r = a - q1 * b;
+    double q2 = r.hi / b.hi;
+    r = r - q2 * b;
+    double q3 = r.hi / b.hi;
+    return dd_detail::quick_two_sum(q1, q2) + q3;
+}
+
+__host__ __device__ inline DoubleDouble &operator+=(DoubleDouble &a, const DoubleDouble &b)
+{
+    return a = a + b;
+}
+
+__host__ __device__ inline DoubleDouble &operator-=(DoubleDouble &a, const DoubleDouble &b)
+{
+    return a = a - b;
+}
+
+__host__ __device__ inline DoubleDouble &operator*=(DoubleDouble &a, const DoubleDouble &b)
+{
+    return a = a * b;
+}
+
+__host__ __device__ inline bool operator<(const DoubleDouble &a, const DoubleDouble &b)
+{
+    return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+}
+
+__host__ __device__ inline bool operator>(const DoubleDouble &a, const DoubleDouble &b)
+{
+    return b < a;
+}
+
+__host__ __device__ inline bool operator<=(const DoubleDouble &a, const DoubleDouble &b)
+{
+    return !(b < a);
+}
+
+__host__ __device__ inline bool operator>=(const DoubleDouble &a, const DoubleDouble &b)
+{
+    return !(a < b);
+}
+
+__host__ __device__ inline bool operator==(const DoubleDouble &a, const DoubleDouble &b)
+{
+    return a.hi == b.hi && a.lo == b.lo;
+}
+
+__host__ __device__ inline bool operator!=(const DoubleDouble &a, const DoubleDouble &b)
+{
+    return !(a == b);
+}
+
+__host__ __device__ inline DoubleDouble abs(const DoubleDouble &a)
+{
+    return a.hi < 0.0 ? -a : a;
+}
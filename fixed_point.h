@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include "hip/hip_runtime.h"
+#include "double_double.h"
+
+// Fixed-point numbers for deterministic deep zooms. Everything is integer
+// arithmetic, so a frame comes out bit for bit the same on every machine,
+// whatever its FPU, compiler flags or math library.
+//
+// Both types keep 8 integer bits (sign included). That covers |z|^2 right
+// after an orbit escapes the default radius of 2, the largest value the
+// escape-time loop produces; bigger radii need the float types.
+// Multiplication truncates the low bits, conversion from double truncates
+// towards zero.
+
+// 64-bit: 56 fraction bits, a little finer than double near 1
+struct Fixed64
+{
+    static constexpr int FRACTION_BITS = 56;
+    int64_t raw = 0;
+
+    Fixed64() = default;
+    __host__ __device__ Fixed64(double value) : raw(int64_t(value * 72057594037927936.0)) {} // 2^56
+    __host__ __device__ Fixed64(const DoubleDouble &value) : raw(Fixed64(value.hi).raw + Fixed64(value.lo).raw) {}
+
+    __host__ __device__ static Fixed64 from_raw(int64_t raw)
+    {
+        Fixed64 r;
+        r.raw = raw;
+        return r;
+    }
+
+    __host__ __device__ explicit operator double() const { return double(raw) / 72057594037927936.0; }
+};
+
+__host__ __device__ inline Fixed64 operator+(Fixed64 a, Fixed64 b) { return Fixed64::from_raw(a.raw + b.raw); }
+__host__ __device__ inline Fixed64 operator-(Fixed64 a, Fixed64 b) { return Fixed64::from_raw(a.raw - b.raw); }
+__host__ __device__ inline Fixed64 operator-(Fixed64 a) { return Fixed64::from_raw(-a.raw); }
+
+__host__ __device__ inline Fixed64 operator*(Fixed64 a, Fixed64 b)
+{
+    return Fixed64::from_raw(int64_t((__int128(a.raw) * b.raw) >> Fixed64::FRACTION_BITS));
+}
+
+__host__ __device__ inline bool operator<(Fixed64 a, Fixed64 b) { return a.raw < b.raw; }
+__host__ __device__ inline bool operator>(Fixed64 a, Fixed64 b) { return a.raw > b.raw; }
+__host__ __device__ inline bool operator<=(Fixed64 a, Fixed64 b) { return a.raw <= b.raw; }
+__host__ __device__ inline bool operator>=(Fixed64 a, Fixed64 b) { return a.raw >= b.raw; }
+__host__ __device__ inline bool operator==(Fixed64 a, Fixed64 b) { return a.raw == b.raw; }
+__host__ __device__ inline bool operator!=(Fixed64 a, Fixed64 b) { return a.raw != b.raw; }
+
+// 128-bit: 120 fraction bits, good to zooms around 1e34
+struct Fixed128
+{
+    static constexpr int FRACTION_BITS = 120;
+    __int128 raw = 0;
+
+    Fixed128() = default;
+    // value * 2^120 does not fit the double to integer conversion, so the
+    // integer and fraction parts of value * 2^60 are converted separately
+    // (both exact, apart from the truncation of bits below 2^-120)
+    __host__ __device__ Fixed128(double value)
+    {
+        const double SCALE = 1152921504606846976.0; // 2^60
+        double scaled = value * SCALE;
+        double whole = trunc(scaled);
+        double fraction = (scaled - whole) * SCALE;
+        raw = __int128(whole) * (__int128(1) << 60) + __int128(fraction);
+    }
+    __host__ __device__ Fixed128(const DoubleDouble &value) : Fixed128(value.hi)
+    {
+        raw += Fixed128(value.lo).raw;
+    }
+
+    __host__ __device__ static Fixed128 from_raw(__int128 raw)
+    {
+        Fixed128 r;
+        r.raw = raw;
+        return r;
+    }
+
+    __host__ __device__ explicit operator double() const
+    {
+        return double(raw >> 60) / 1152921504606846976.0 + double(raw & ((__int128(1) << 60) - 1)) / 1329227995784915872903807060280344576.0; // 2^60, 2^120
+    }
+};
+
+__host__ __device__ inline Fixed128 operator+(Fixed128 a, Fixed128 b) { return Fixed128::from_raw(a.raw + b.raw); }
+__host__ __device__ inline Fixed128 operator-(Fixed128 a, Fixed128 b) { return Fixed128::from_raw(a.raw - b.raw); }
+__host__ __device__ inline Fixed128 operator-(Fixed128 a) { return Fixed128::from_raw(-a.raw); }
+
+// 128 x 128 -> 256 bit product of the magnitudes from four 64 x 64 -> 128
+// multiplies, keeping bits 120..247
+__host__ __device__ inline Fixed128 operator*(Fixed128 a, Fixed128 b)
+{
+    using u128 = unsigned __int128;
+    bool negative = (a.raw < 0) != (b.raw < 0);
+    u128 ua = a.raw < 0 ? -u128(a.raw) : u128(a.raw);
+    u128 ub = b.raw < 0 ? -u128(b.raw) : u128(b.raw);
+
+    uint64_t a_lo = uint64_t(ua), a_hi = uint64_t(ua >> 64);
+    uint64_t b_lo = uint64_t(ub), b_hi = uint64_t(ub >> 64);
+    u128 ll = u128(a_lo) * b_lo;
+    u128 lh = u128(a_lo) * b_hi;
+    u128 hl = u128(a_hi) * b_lo;
+    u128 hh = u128(a_hi) * b_hi;
+
+    // bits 64..127 and the carry out of them
+    u128 mid = (ll >> 64) + uint64_t(lh) + uint64_t(hl);
+    // bits 128..255
+    u128 high = hh + (lh >> 64) + (hl >> 64) + (mid >> 64);
+
+    u128 r = (high << (128 - Fixed128::FRACTION_BITS)) | (uint64_t(mid) >> (Fixed128::FRACTION_BITS - 64));
+    return Fixed128::from_raw(negative ? -__int128(r) : __int128(r));
+}
+
+__host__ __device__ inline bool operator<(Fixed128 a, Fixed128 b) { return a.raw < b.raw; }
+__host__ __device__ inline bool operator>(Fixed128 a, Fixed128 b) { return a.raw > b.raw; }
+__host__ __device__ inline bool operator<=(Fixed128 a, Fixed128 b) { return a.raw <= b.raw; }
+__host__ __device__ inline bool operator>=(Fixed128 a, Fixed128 b) { return a.raw >= b.raw; }
+__host__ __device__ inline bool operator==(Fixed128 a, Fixed128 b) { return a.raw == b.raw; }
+__host__ __device__ inline bool operator!=(Fixed128 a, Fixed128 b) { return a.raw != b.raw; }
@@ -0,0 +1,400 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include "hip/hip_runtime.h"
+
+constexpr uint32_t MAX_ITERATION = 255;
+constexpr double ESCAPE_RADIUS = 2.0;
+
+// Iteration settings that can change while the program runs
+struct FractalParams
+{
+    uint32_t max_iteration = MAX_ITERATION;
+    double escape_radius = ESCAPE_RADIUS;
+    // resolve mandelbrot points in the main cardioid and period-2 bulb
+    // analytically instead of iterating them
+    bool interior_test = true;
+    // stop once the orbit comes back within this distance (per component) of
+    // an earlier point, 0 turns cycle detection off
+    double periodicity_tolerance = 1e-12;
+};
+
+// Work done by a kernel call, for the timing output
+struct KernelStats
+{
+    // iterations run by pixels that escaped or reached the cap
+    uint64_t iterations = 0;
+    // pixels answered by the cardioid / bulb test without iterating
+    uint64_t skipped = 0;
+    // pixels that stopped early on an attracting cycle
+    uint64_t periodic = 0;
+
+    KernelStats &operator+=(const KernelStats &other)
+    {
+        iterations += other.iterations;
+        skipped += other.skipped;
+        periodic += other.periodic;
+        return *this;
+    }
+};
+
+// Arithmetic a frame is rendered in, cheapest first
+enum class Precision
+{
+    float32,
+    float64,
+    double_double,
+    // deterministic integer arithmetic, chosen with --fixed-point
+    fixed64,
+    fixed128,
+};
+
+inline const char *precision_name(Precision precision)
+{
+    switch (precision)
+    {
+    case Precision::float32:
+        return "float";
+    case Precision::float64:
+        return "double";
+    case Precision::fixed64:
+        return "fixed64";
+    case Precision::fixed128:
+        return "fixed128";
+    default:
+        return "double-double";
+    }
+}
+
+// A type is used while neighbouring pixels are at least this many of its
+// ulps apart at the largest coordinate in view. Below that the rounded pixel
+// coordinates start to collapse onto each other.
+constexpr double MIN_ULPS_PER_PIXEL = 16;
+
+// 2^-104, the relative precision of DoubleDouble
+constexpr double DOUBLE_DOUBLE_EPSILON = 4.930380657631324e-32;
+
+// Picks the cheapest precision for a view with pixel spacing step whose
+// coordinates reach up to extent in magnitude. Going back to a cheaper type
+// needs twice the margin, so zooming in and out around a threshold does not
+// flip the image between the two every frame.
+inline Precision choose_precision(double step, double extent, const FractalParams &params, Precision current)
+{
+    double scale = std::max(extent, 1.0);
+    auto enough = [&](Precision precision, double epsilon) {
+        double needed = current <= precision ? MIN_ULPS_PER_PIXEL : 2 * MIN_ULPS_PER_PIXEL;
+        return step >= needed * scale * epsilon;
+    };
+
+    // bailout has to fit in a float as well
+    bool float_bailout = params.escape_radius * params.escape_radius < double(std::numeric_limits<float>::max());
+    if (float_bailout && enough(Precision::float32, std::numeric_limits<float>::epsilon()))
+    {
+        return Precision::float32;
+    }
+    if (enough(Precision::float64, std::numeric_limits<double>::epsilon()))
+    {
+        return Precision::float64;
+    }
+    return Precision::double_double;
+}
+
+// Fixed-point stand-in for double-double: Fixed64 while pixels are at least
+// MIN_ULPS_PER_PIXEL of its 2^-56 steps apart, Fixed128 below that.
+inline Precision choose_fixed_precision(double step)
+{
+    return step >= MIN_ULPS_PER_PIXEL * 1.3877787807814457e-17 ? Precision::fixed64 : Precision::fixed128;
+}
+
+// The fixed-point types only have the integer range for the default radius
+inline bool fixed_point_supported(const FractalParams &params)
+{
+    return params.escape_radius <= ESCAPE_RADIUS;
+}
+
+// Both formulas iterate z = z^2 + c, they differ in where z0 and c come from:
+// the mandelbrot set uses the pixel for both, the julia set starts from the
+// pixel with a fixed c.
+enum class Formula
+{
+    mandelbrot,
+    julia,
+};
+
+// Passed as MaxIter to take max_iteration and escape_radius from the
+// FractalParams at runtime instead of compiling them in.
+constexpr uint32_t DYNAMIC_ITERATION = 0;
+
+// Iteration caps with their own compiled kernel. The escape radius has to
+// be the default for these to be used.
+constexpr uint32_t SPECIALIZED_ITERATIONS[] = {255, 1023, 4095};
+
+// Main cardioid: q (q + (x - 1/4)) <= y^2 / 4 with q = (x - 1/4)^2 + y^2.
+// Period-2 bulb: the disc of radius 1/4 around -1. Points in either never
+// escape; returns the period of their attracting cycle (1 or 2), or 0 when
+// the point is in neither. The SIMD kernels evaluate the same expressions in
+// the same order.
+template <typename Real>
+__host__ __device__ inline uint32_t cardioid_or_bulb_period(Real x, Real y)
+{
+    Real y2 = y * y;
+    Real xq = x - Real(0.25);
+    Real q = xq * xq + y2;
+    if (q * (q + xq) <= Real(0.25) * y2)
+    {
+        return 1;
+    }
+    Real xb = x + Real(1.0);
+    return xb * xb + y2 <= Real(0.0625) ? 2 : 0;
+}
+
+// A bounded orbit never leaves |z| <= 2, so the interior test agrees with
+// iterating as long as the escape radius is at least that.
+__host__ __device__ inline bool use_interior_test(const FractalParams &params)
+{
+    return params.interior_test && params.escape_radius >= ESCAPE_RADIUS;
+}
+
+// The single escape-time loop every CPU and GPU path is built on.
+//
+// Returns how many iterations ran without escaping, starting from z0; a
+// point that never escapes returns the iteration cap. Real may be float,
+// double, or long double (host only).
+//
+// Interior points are caught early by Brent's cycle detection: the orbit is
+// compared against a saved point that jumps forward at every power of two,
+// so any cycle is found within a few times its period after the orbit has
+// settled. The first saved point is z1 rather than z0: z0 and -z0 have the
+// same orbit from z1 on, so they come out the same, which the julia view's
+// rotation relies on. The cycle length goes to *period (0 when none was
+// found).
+template <typename Real, Formula F, uint32_t MaxIter = DYNAMIC_ITERATION>
+__host__ __device__ inline uint32_t escape_time(Real px, Real py, Real cr, Real ci, const FractalParams &params, uint32_t *period = nullptr)
+{
+    uint32_t max_iteration;
+    Real bailout;
+    if constexpr (MaxIter == DYNAMIC_ITERATION)
+    {
+        max_iteration = params.max_iteration;
+        bailout = Real(params.escape_radius) * Real(params.escape_radius);
+    }
+    else
+    {
+        max_iteration = MaxIter;
+        bailout = Real(ESCAPE_RADIUS * ESCAPE_RADIUS);
+    }
+
+    if constexpr (F == Formula::mandelbrot)
+    {
+        cr = px;
+        ci = py;
+        uint32_t interior = use_interior_test(params) ? cardioid_or_bulb_period(px, py) : 0;
+        if (interior)
+        {
+            if (period)
+            {
+                *period = interior;
+            }
+            return max_iteration;
+        }
+    }
+
+    const Real tolerance = Real(params.periodicity_tolerance);
+    const bool check_period = tolerance > Real(0);
+    Real saved_x = px, saved_y = py;
+    uint32_t saved_at = 0, next_save = 1;
+
+    // same operation order as the SIMD kernels, so the counts match exactly
+    Real x = px, y = py;
+    Real x2 = x * x, y2 = y * y;
+    uint32_t i = 0;
+    for (; i < max_iteration; i++)
+    {
+        y = (x + x) * y + ci;
+        x = (x2 - y2) + cr;
+        x2 = x * x;
+        y2 = y * y;
+        if (x2 + y2 > bailout)
+        {
+            break;
+        }
+
+        if (check_period)
+        {
+            if (saved_at > 0)
+            {
+                // z_n with n = i + 1, the saved point is z_saved_at
+                Real dx = x - saved_x;
+                Real dy = y - saved_y;
+                if (dx < tolerance && -dx < tolerance && dy < tolerance && -dy < tolerance)
+                {
+                    if (period)
+                    {
+                        *period = i + 1 - saved_at;
+                    }
+                    return max_iteration;
+                }
+            }
+            if (i + 1 == next_save)
+            {
+                saved_x = x;
+                saved_y = y;
+                saved_at = i + 1;
+                next_save *= 2;
+            }
+        }
+    }
+    if (period)
+    {
+        *period = 0;
+    }
+    return i;
+}
+
+// Calls body with std::integral_constant<uint32_t, N>, where N is the
+// specialized iteration cap matching params, or DYNAMIC_ITERATION.
+template <typename Body>
+inline auto with_iteration_cap(const FractalParams &params, Body &&body)
+{
+    if (params.escape_radius == ESCAPE_RADIUS)
+    {
+        switch (params.max_iteration)
+        {
+        case SPECIALIZED_ITERATIONS[0]:
+            return body(std::integral_constant<uint32_t, SPECIALIZED_ITERATIONS[0]>{});
+        case SPECIALIZED_ITERATIONS[1]:
+            return body(std::integral_constant<uint32_t, SPECIALIZED_ITERATIONS[1]>{});
+        case SPECIALIZED_ITERATIONS[2]:
+            return body(std::integral_constant<uint32_t, SPECIALIZED_ITERATIONS[2]>{});
+        }
+    }
+    return body(std::integral_constant<uint32_t, DYNAMIC_ITERATION>{});
+}
+
+// Scalar kernel over a coordinate map, for the CPU fallback and as the
+// reference the SIMD kernels are checked against.
+// period may be null when the cycle lengths are not needed. Count is as in
+// escape_time_grid_rows().
+template <typename Real, Formula F, typename Count>
+KernelStats escape_time_span(const double *xr, const double *xi, double cr, double ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    bool interior_test = F == Formula::mandelbrot && use_interior_test(params);
+    return with_iteration_cap(params, [&](auto max_iter) {
+        KernelStats stats;
+        for (int i = 0; i < n; i++)
+        {
+            uint32_t p = 0;
+            uint32_t count = escape_time<Real, F, decltype(max_iter)::value>(Real(xr[i]), Real(xi[i]), Real(cr), Real(ci), params, &p);
+            bitmap[i] = Count(count);
+            if (period)
+            {
+                period[i] = Count(p);
+            }
+            if (p == 0)
+            {
+                stats.iterations += count;
+            }
+            // a cycle was found, either analytically or by iterating
+            else if (interior_test && cardioid_or_bulb_period(Real(xr[i]), Real(xi[i])))
+            {
+                stats.skipped++;
+            }
+            else
+            {
+                stats.periodic++;
+            }
+        }
+        return stats;
+    });
+}
+
+// Scalar kernel over rows [row_begin, row_end) of a grid width pixels wide,
+// row-major, with pixel (x, y) at (x0 + x * step, y0 + y * step). For number
+// types that do not fit in a double coordinate map. Only the origin needs the
+// extra precision, the offset from it is exact enough in double. A pixel comes
+// out the same whichever row range it was computed in, so the rows can be
+// split between threads. The results go to bitmap and period as Count,
+// any integer type that holds the iteration cap (see count_type()).
+template <typename Real, Formula F, typename Count>
+KernelStats escape_time_grid_rows(Real x0, Real y0, double step, Real cr, Real ci, Count *bitmap, Count *period, int width, int row_begin, int row_end, const FractalParams &params)
+{
+    return with_iteration_cap(params, [&](auto max_iter) {
+        KernelStats stats;
+        for (int y = row_begin; y < row_end; y++)
+        {
+            Real py = y0 + Real(y * step);
+            for (int x = 0; x < width; x++)
+            {
+                Real px = x0 + Real(x * step);
+                uint32_t p = 0;
+                int i = width * y + x;
+                uint32_t count = escape_time<Real, F, decltype(max_iter)::value>(px, py, cr, ci, params, &p);
+                bitmap[i] = Count(count);
+                if (period)
+                {
+                    period[i] = Count(p);
+                }
+                if (p == 0)
+                {
+                    stats.iterations += count;
+                }
+                else if (F == Formula::mandelbrot && use_interior_test(params) && cardioid_or_bulb_period(px, py))
+                {
+                    stats.skipped++;
+                }
+                else
+                {
+                    stats.periodic++;
+                }
+            }
+        }
+        return stats;
+    });
+}
+
+// whole width x height grid
+template <typename Real, Formula F, typename Count>
+KernelStats escape_time_grid(Real x0, Real y0, double step, Real cr, Real ci, Count *bitmap, Count *period, int width, int height, const FractalParams &params)
+{
+    return escape_time_grid_rows<Real, F>(x0, y0, step, cr, ci, bitmap, period, width, 0, height, params);
+}
+
+// Grid kernel over a list of pixels of a grid width pixels wide, for frames
+// rendered a few pixels at a time. Pixel k of the list sits at
+// (pixels[k] % width, pixels[k] / width) and its results are packed into
+// bitmap[k] and period[k].
+template <typename Real, Formula F, typename Count>
+KernelStats escape_time_pixels(Real x0, Real y0, double step, Real cr, Real ci, const int *pixels, int width, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    return with_iteration_cap(params, [&](auto max_iter) {
+        KernelStats stats;
+        for (int k = 0; k < n; k++)
+        {
+            Real px = x0 + Real(pixels[k] % width * step);
+            Real py = y0 + Real(pixels[k] / width * step);
+            uint32_t p = 0;
+            uint32_t count = escape_time<Real, F, decltype(max_iter)::value>(px, py, cr, ci, params, &p);
+            bitmap[k] = Count(count);
+            if (period)
+            {
+                period[k] = Count(p);
+            }
+            if (p == 0)
+            {
+                stats.iterations += count;
+            }
+            else if (F == Formula::mandelbrot && use_interior_test(params) && cardioid_or_bulb_period(px, py))
+            {
+                stats.skipped++;
+            }
+            else
+            {
+                stats.periodic++;
+            }
+        }
+        return stats;
+    });
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Iteration counts and periods are kept per pixel in the narrowest unsigned
+// type that holds every value up to the iteration cap: a count never exceeds
+// the cap, and neither does the period of a cycle found within it.
+enum class CountType
+{
+    u8,
+    u16,
+    u32,
+};
+
+inline CountType count_type(uint32_t max_iteration)
+{
+    if (max_iteration <= UINT8_MAX)
+    {
+        return CountType::u8;
+    }
+    if (max_iteration <= UINT16_MAX)
+    {
+        return CountType::u16;
+    }
+    return CountType::u32;
+}
+
+inline size_t count_size(CountType type)
+{
+    return type == CountType::u8 ? 1 : type == CountType::u16 ? 2 : 4;
+}
+
+// Calls body with a null pointer to the integer type of type, to pick a
+// template instance at run time like with_iteration_cap()
+template <typename Body>
+inline auto with_count_type(CountType type, Body &&body)
+{
+    switch (type)
+    {
+    case CountType::u8:
+        return body(static_cast<uint8_t *>(nullptr));
+    case CountType::u16:
+        return body(static_cast<uint16_t *>(nullptr));
+    default:
+        return body(static_cast<uint32_t *>(nullptr));
+    }
+}
+
+// Counts and periods of pixels [begin, end) of a view, copied out of its
+// buffers as raw bytes, with the cap of the frame they were written for
+struct CountSnapshot
+{
+    uint32_t max_iteration = UINT32_MAX;
+    int begin = 0;
+    int end = 0;
+    std::vector<unsigned char> counts;
+    std::vector<unsigned char> periods;
+};
+
+// Counts and periods of a view of n pixels, in the type of the frame they
+// hold. The storage is sized for uint32_t, so switching types never moves
+// it; a frame of a narrower type only touches the start of it, and the pages
+// past that are never committed. The buffers belong to the thread rendering
+// into them, any other one goes through snapshot().
+class CountBuffers
+{
+public:
+    CountBuffers() = default;
+    CountBuffers(const CountBuffers &) = delete;
+    CountBuffers &operator=(const CountBuffers &) = delete;
+
+    ~CountBuffers()
+    {
+        std::free(counts_);
+        std::free(periods_);
+    }
+
+    void allocate(size_t n)
+    {
+        n_ = n;
+        counts_ = std::calloc(n, sizeof(uint32_t));
+        periods_ = std::calloc(n, sizeof(uint32_t));
+    }
+
+    // the type follows from the cap, so the two always agree
+    CountType type() const { return count_type(max_iteration_); }
+    // the cap of the frame they hold, for scaling the counts
+    uint32_t max_iteration() const { return max_iteration_; }
+    // For a frame with this iteration cap. The contents mean nothing in the
+    // new type until they are rewritten, which is why other threads only
+    // see the cap along with the counts of a snapshot.
+    void set_max_iteration(uint32_t max_iteration)
+    {
+        max_iteration_ = max_iteration;
+    }
+
+    template <typename Count>
+    Count *counts() const
+    {
+        return static_cast<Count *>(counts_);
+    }
+    template <typename Count>
+    Count *periods() const
+    {
+        return static_cast<Count *>(periods_);
+    }
+
+    // body(counts, periods) with the pointers in the current type
+    template <typename Body>
+    auto visit(Body &&body) const
+    {
+        return with_count_type(type(), [&](auto *tag) {
+            using Count = std::remove_pointer_t<decltype(tag)>;
+            return body(counts<Count>(), periods<Count>());
+        });
+    }
+
+    // Copy of pixels [begin, end), for a thread that does not own the
+    // buffers: they are never read while another thread writes them.
+    CountSnapshot snapshot(int begin, int end) const
+    {
+        size_t size = count_size(type());
+        CountSnapshot snapshot;
+        snapshot.max_iteration = max_iteration_;
+        snapshot.begin = begin;
+        snapshot.end = end;
+        const unsigned char *counts = static_cast<const unsigned char *>(counts_);
+        const unsigned char *periods = static_cast<const unsigned char *>(periods_);
+        snapshot.counts.assign(counts + begin * size, counts + end * size);
+        snapshot.periods.assign(periods + begin * size, periods + end * size);
+        return snapshot;
+    }
+
+    // Writes a snapshot back, converting the buffers to its cap first
+    void store(const CountSnapshot &snapshot)
+    {
+        if (snapshot.max_iteration != max_iteration_)
+        {
+            convert(snapshot.max_iteration);
+        }
+        size_t size = count_size(type());
+        std::memcpy(static_cast<unsigned char *>(counts_) + snapshot.begin * size, snapshot.counts.data(), snapshot.counts.size());
+        std::memcpy(static_cast<unsigned char *>(periods_) + snapshot.begin * size, snapshot.periods.data(), snapshot.periods.size());
+    }
+
+    // For a frame with another cap, keeping the counts, clamped to it
+    void convert(uint32_t max_iteration)
+    {
+        std::vector<uint32_t> counts(n_), periods(n_);
+        visit([&](const auto *bitmap, const auto *period) {
+            std::copy(bitmap, bitmap + n_, counts.begin());
+            std::copy(period, period + n_, periods.begin());
+        });
+        set_max_iteration(max_iteration);
+        visit([&](auto *bitmap, auto *period) {
+            using Count = std::remove_pointer_t<decltype(bitmap)>;
+            for (size_t i = 0; i < n_; i++)
+            {
+                bitmap[i] = Count(std::min(counts[i], max_iteration));
+                period[i] = Count(std::min(periods[i], max_iteration));
+            }
+        });
+    }
+
+private:
+    size_t n_ = 0;
+    void *counts_ = nullptr;
+    void *periods_ = nullptr;
+    uint32_t max_iteration_ = UINT32_MAX;
+};
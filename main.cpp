@@ -1,36 +1,142 @@
 #define OLC_PGE_APPLICATION
 
+#include <atomic>
+#include <cmath>
 #include <complex>
+#include <condition_variable>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <vector>
 #include <fmt/core.h>
 #include "hip/hip_runtime.h"
 #include "olcPixelGameEngine.h"
+#include "fractal.h"
+#include "iteration_counts.h"
+#include "double_double.h"
+#include "fixed_point.h"
+#include "perturbation.h"
+#include "boundary_trace.h"
+#include "simd_kernels.h"
+#include "thread_pool.h"
+#include "tile_cache.h"
 
 using std::complex;
 using complex_d = std::complex<double>;
 
-constexpr uint32_t MAX_ITERATION = 255;
+// render threads when hardware_concurrency() cannot tell
 constexpr uint32_t N_THREAD = 30;
+// set by --threads, otherwise one per hardware thread
+uint32_t THREAD_N = 0;
+// pixels per task when a CPU render is split between threads, small enough
+// for the tasks to even out between the fast exterior and slow boundary
+constexpr int CPU_TASK_PIXELS = 4096;
+// pixels whose coordinates the float and double CPU kernels get at a time,
+// looked up on the stack from the view's PixelAxes
+constexpr int GRID_CHUNK_PIXELS = 256;
 
 int GPU_THREAD_N = 256;
 int n_data;
 bool GPU_CALC = true;
+// set by --precision, otherwise picked per frame from the pixel step
+std::optional<Precision> FORCED_PRECISION;
+// render double-double views on the CPU by perturbation instead of iterating
+// every pixel in double-double
+bool PERTURBATION = true;
+// skip the first iterations of every perturbed pixel with a series
+// approximation
+bool SERIES_APPROXIMATION = true;
+// render views past double precision in fixed point, bit for bit the same on
+// every machine
+bool FIXED_POINT = false;
+// render CPU mandelbrot frames coarse to fine, see PROGRESSIVE_STRIDES
+bool PROGRESSIVE = true;
+// set by --bench: the display times its render stages instead of opening a
+// window, and renders nothing in the background
+bool BENCHMARK = false;
+// Pixel spacing of the progressive passes. Each pass computes the pixels on
+// its lattice that the coarser ones have not, then shows every computed
+// pixel as a stride x stride block until a finer pass replaces it.
+constexpr int PROGRESSIVE_STRIDES[] = {8, 4, 2, 1};
+
+// How the CPU path computes frames, switched with the M key
+enum class RenderMode
+{
+    // every pixel
+    brute_force,
+    // Mariani-Silver, see subdivision.h. Mandelbrot only, julia sets need
+    // not be connected
+    subdivision,
+    // see boundary_trace.h, both views
+    boundary_trace,
+};
 
-void save_to_csv(double *values, std::string name, int width, int height)
+const char *render_mode_name(RenderMode mode)
 {
-    auto filename = name + ".csv";
-    std::ofstream csv(filename);
-    for (int y = 0; y < height; y++)
+    switch (mode)
     {
-        for (int x = 0; x < width; x++)
-        {
-            csv << values[width * y + x] << ",";
-        }
-        csv << "\n";
+    case RenderMode::brute_force:
+        return "brute-force";
+    case RenderMode::subdivision:
+        return "subdivision";
+    case RenderMode::boundary_trace:
+        return "boundary-trace";
+    }
+    return "?";
+}
+
+// set by --renderer
+RenderMode RENDER_MODE = RenderMode::brute_force;
+// square tiles the subdivision and boundary tracing renderers split a frame
+// into, one task each, and the tiles of the tile cache
+constexpr int RENDER_TILE = 64;
+// memory for the tile cache in MB, set by --tile-cache, 0 turns it off
+size_t TILE_CACHE_MB = 256;
+
+// Every mouse wheel notch zooms by ZOOM_STEP. The zoom of a level is always
+// computed the same way, so views of one level share a pixel lattice.
+constexpr double ZOOM_STEP = 1.25;
+
+DoubleDouble zoom_at_level(int level)
+{
+    DoubleDouble zoom = 1.0;
+    for (int i = 0; i < level; i++)
+    {
+        zoom *= ZOOM_STEP;
+    }
+    return zoom;
+}
+
+// Nearest integer, if it fits comfortably in 64 bits
+std::optional<int64_t> round_to_int64(const DoubleDouble &value)
+{
+    if (!(std::abs(value.hi) < 0x1p62))
+    {
+        return std::nullopt;
     }
-    csv << "\n";
-    csv.close();
+    double hi = std::round(value.hi);
+    return int64_t(hi) + int64_t(std::round((value.hi - hi) + value.lo));
+}
+
+// exact, where a plain conversion to double drops the low bits
+DoubleDouble to_double_double(int64_t value)
+{
+    double hi = double(value);
+    return {hi, double(value - int64_t(hi))};
+}
+
+// Moves a view coordinate onto the pixel lattice of its level, or leaves it
+// where it is past 64-bit pixel indices
+DoubleDouble snap_to_lattice(const DoubleDouble &value, const DoubleDouble &step)
+{
+    std::optional<int64_t> index = round_to_int64(value / step);
+    return index ? to_double_double(*index) * step : value;
 }
 
 static inline int64_t rdsysns()
@@ -39,158 +145,633 @@ static inline int64_t rdsysns()
     return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
 }
 
-complex_d sequence(complex_d z, complex_d c)
+uint64_t total_power_count = 0;
+uint64_t skipped_pixel_count = 0;
+uint64_t periodic_pixel_count = 0;
+
+uint32_t mandelbrot(complex_d c, const FractalParams &params = FractalParams{})
+{
+    return escape_time<double, Formula::mandelbrot>(c.real(), c.imag(), 0.0, 0.0, params);
+}
+
+uint32_t julia(complex_d z, complex_d c, const FractalParams &params = FractalParams{})
+{
+    return escape_time<double, Formula::julia>(z.real(), z.imag(), c.real(), c.imag(), params);
+}
+
+// Scalar kernels with the same signature as the SIMD ones, so they can
+// stand in for them as the fallback.
+template <typename Real, typename Count>
+KernelStats mandelbrot_scalar(const double *cr, const double *ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    return escape_time_span<Real, Formula::mandelbrot>(cr, ci, 0.0, 0.0, bitmap, period, n, params);
+}
+
+template <typename Real, typename Count>
+KernelStats julia_scalar(const double *xr, const double *xi, double cr, double ci, Count *bitmap, Count *period, int n, const FractalParams &params)
 {
-    return std::pow(z, 2) + c;
+    return escape_time_span<Real, Formula::julia>(xr, xi, cr, ci, bitmap, period, n, params);
 }
 
-int total_power_count = 0;
+// selected once at startup by select_cpu_kernels()
+Isa cpu_isa = Isa::scalar;
 
-uint32_t mandelbrot(complex_d c)
+// The CPU kernels of isa writing Count, the scalar ones or the SIMD ones
+template <typename Count>
+CpuKernels<Count> cpu_kernels(Isa isa = cpu_isa)
 {
-    double escape_radios = 2.0;
-    complex_d n = c;
-    uint32_t i = 0;
-    for (; i < MAX_ITERATION; i++)
+    if (isa == Isa::scalar)
     {
-        n = sequence(n, c);
-        if (std::abs(n) > escape_radios)
-        {
-            break;
-        }
+        return {mandelbrot_scalar<double, Count>, julia_scalar<double, Count>, mandelbrot_scalar<float, Count>, julia_scalar<float, Count>};
     }
-    total_power_count += i;
-    return i;
+    return simd_kernels<Count>(isa);
 }
 
-uint32_t julia(complex_d x, complex_d c)
+// Pick the widest kernel the CPU supports. A forced ISA (from --isa or the
+// FRACTAL_ISA environment variable) wins as long as the CPU can run it.
+void select_cpu_kernels(const std::string &forced)
 {
-    double escape_radios = 2.0;
-    uint32_t i = 0;
-    for (; i < MAX_ITERATION; i++)
+    Isa isa = detect_isa();
+    if (!forced.empty())
     {
-        x = sequence(x, c);
-        if (std::abs(x) > escape_radios)
+        Isa wanted;
+        if (!parse_isa(forced, wanted))
+        {
+            fmt::print("unknown isa '{}', using {}\n", forced, isa_name(isa));
+        }
+        else if (!isa_supported(wanted))
+        {
+            fmt::print("isa {} not supported by this cpu, using {}\n", forced, isa_name(isa));
+        }
+        else
         {
-            break;
+            isa = wanted;
         }
     }
+    cpu_isa = isa;
+    fmt::print("cpu kernels: {} (detected {})\n", isa_name(cpu_isa), isa_name(detect_isa()));
+}
+
+// A render running in the background: the generation it was started for,
+// and who to tell about the pixels it finished
+struct RenderJob
+{
+    JobGeneration generation;
+    // called from the worker threads with each finished [begin, end) range
+    // of pixels, may be empty
+    std::function<void(int, int)> tile_done;
+};
 
-    return i;
+// Runs kernel(begin, end) over [0, n) in tasks of grain on the pool and sums
+// the stats it returns. Each task covers pixels_per_unit pixels per unit of
+// n, for reporting the finished tiles.
+template <typename Kernel>
+KernelStats parallel_kernel(ThreadPool &pool, int n, int grain, int pixels_per_unit, const RenderJob &job, Kernel kernel)
+{
+    std::mutex mutex;
+    KernelStats total;
+    pool.parallel_for(n, grain, [&](int begin, int end) {
+        KernelStats stats = kernel(begin, end);
+        if (job.tile_done)
+        {
+            job.tile_done(begin * pixels_per_unit, end * pixels_per_unit);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        total += stats;
+    }, job.generation);
+    return total;
 }
 
-__global__ void mandelbrot_gpu(double *cr, double *ci, int *bitmap, int NPIXEL)
+// Pixel coordinates of a float or double view: pixel (x, y) of a grid
+// width pixels wide sits at ((x + offset_x) * step + origin_x, (y +
+// offset_y) * step + origin_y), worked out in double-double and rounded
+// once. The kernels compute them from the pixel index as they go instead of
+// reading a coordinate map.
+struct PixelGrid
 {
-    int id = blockDim.x * blockIdx.x + threadIdx.x;
-    if (id < NPIXEL)
+    DoubleDouble origin_x, origin_y;
+    DoubleDouble step;
+    int64_t offset_x = 0, offset_y = 0;
+    int width = 0;
+
+    __host__ __device__ double x(int pixel) const
+    {
+        return coordinate(pixel % width + offset_x, origin_x);
+    }
+    __host__ __device__ double y(int pixel) const
     {
-        // complex_d c{cr[id], ci[id]};
-        double x0 = cr[id];
-        double y0 = ci[id];
-        int escape = 0;
-        double escape_radios = 2.0;
-        // complex_d n = c;
-        int i = 0;
-        double x = 0.0, x2 = 0.0, y = 0.0, y2 = 0.0;
+        return coordinate(pixel / width + offset_y, origin_y);
+    }
 
-        double w = 0.0;
-        while (x2 + y2 <= 4 && i < MAX_ITERATION)
+    __host__ __device__ double coordinate(int64_t offset, const DoubleDouble &origin) const
+    {
+        // a double step from the origin, as in the julia view: the product
+        // rounded once is the same number, without the double-double work
+        if (origin.hi == 0.0 && step.lo == 0.0)
         {
-            y = 2 * x * y + y0;
-            x = x2 - y2 + x0;
+            return double(offset) * step.hi;
+        }
+        return double(DoubleDouble(double(offset)) * step + origin);
+    }
+};
+
+// Coordinates of every column and row of a PixelGrid. The pixels of a row
+// share y and every row repeats the same x values, so the CPU kernels look
+// them up in width + height doubles (small enough to stay in cache)
+// instead of working each pixel out in double-double.
+struct PixelAxes
+{
+    std::vector<double> x, y;
+    int width = 0;
 
-            x2 = x * x;
-            y2 = y * y;
+    PixelAxes() = default;
+    PixelAxes(const PixelGrid &grid, int height)
+    {
+        fill(grid, height);
+    }
 
-            ++i;
+    // reuses the storage of the last view
+    void fill(const PixelGrid &grid, int height)
+    {
+        width = grid.width;
+        x.resize(width);
+        y.resize(height);
+        for (int i = 0; i < width; i++)
+        {
+            x[i] = grid.x(i);
+        }
+        for (int i = 0; i < height; i++)
+        {
+            y[i] = grid.y(width * i);
         }
+    }
+};
 
-        bitmap[id] = i;
+// Runs a coordinate array kernel, kernel(xr, xi, bitmap, period, n), over the
+// n listed pixels of a view. The coordinates are looked up a chunk at a
+// time, so they stay in L1; results are packed like escape_time_pixels().
+template <typename Count, typename Kernel>
+KernelStats grid_kernel(const PixelAxes &axes, const int *pixels, Count *bitmap, Count *period, int n, Kernel kernel)
+{
+    KernelStats stats;
+    double xr[GRID_CHUNK_PIXELS], xi[GRID_CHUNK_PIXELS];
+    for (int begin = 0; begin < n; begin += GRID_CHUNK_PIXELS)
+    {
+        int count = std::min(GRID_CHUNK_PIXELS, n - begin);
+        for (int k = 0; k < count; k++)
+        {
+            xr[k] = axes.x[pixels[begin + k] % axes.width];
+            xi[k] = axes.y[pixels[begin + k] / axes.width];
+        }
+        stats += kernel(xr, xi, bitmap + begin, period ? period + begin : nullptr, count);
     }
+    return stats;
+}
+
+// CPU path for float and double views, over n listed pixels of a view
+template <typename Count>
+void mandelbrot_cpu(ThreadPool &pool, const PixelAxes &axes, const int *pixels, Count *bitmap, Count *period, int n, const FractalParams &params, Precision precision, const RenderJob &job = {})
+{
+    CpuKernels<Count> kernels = cpu_kernels<Count>();
+    auto kernel = precision == Precision::float32 ? kernels.mandelbrot_float : kernels.mandelbrot;
+    KernelStats stats = parallel_kernel(pool, n, CPU_TASK_PIXELS, 1, job, [&](int begin, int end) {
+        return grid_kernel(axes, pixels + begin, bitmap + begin, period + begin, end - begin, [&](const double *cr, const double *ci, Count *b, Count *p, int count) {
+            return kernel(cr, ci, b, p, count, params);
+        });
+    });
+    total_power_count += stats.iterations;
+    skipped_pixel_count += stats.skipped;
+    periodic_pixel_count += stats.periodic;
+}
+
+// CPU path for views past double precision, the pixel coordinates are
+// generated in Real (double-double or fixed point) from the view origin.
+// Computes the n listed pixels of a grid width pixels wide, with the
+// results packed like escape_time_pixels().
+template <typename Real, typename Count>
+void mandelbrot_cpu_grid(ThreadPool &pool, Real x0, Real y0, double step, int width, const int *pixels, Count *bitmap, Count *period, int n, const FractalParams &params, const RenderJob &job = {})
+{
+    KernelStats stats = parallel_kernel(pool, n, CPU_TASK_PIXELS, 1, job, [&](int begin, int end) {
+        return escape_time_pixels<Real, Formula::mandelbrot>(x0, y0, step, 0.0, 0.0, pixels + begin, width, bitmap + begin, period + begin, end - begin, params);
+    });
+    total_power_count += stats.iterations;
+    skipped_pixel_count += stats.skipped;
+    periodic_pixel_count += stats.periodic;
+}
+
+// CPU path for the julia set, c is shared by every pixel
+template <typename Count>
+void julia_cpu(ThreadPool &pool, const PixelAxes &axes, const int *pixels, complex_d c, Count *bitmap, Count *period, int n, const FractalParams &params, Precision precision, const RenderJob &job = {})
+{
+    CpuKernels<Count> kernels = cpu_kernels<Count>();
+    auto kernel = precision == Precision::float32 ? kernels.julia_float : kernels.julia;
+    parallel_kernel(pool, n, CPU_TASK_PIXELS, 1, job, [&](int begin, int end) {
+        return grid_kernel(axes, pixels + begin, bitmap + begin, period + begin, end - begin, [&](const double *xr, const double *xi, Count *b, Count *p, int count) {
+            return kernel(xr, xi, c.real(), c.imag(), b, p, count, params);
+        });
+    });
 }
 
-__global__ void julia_gpu(double *xr, double *xi, double cr, double ci, int *bitmap, int NPIXEL)
+// Thread id computes pixels[id] of grid, or pixel id when pixels is null,
+// into bitmap[id]. period may be null when the cycle lengths are not needed.
+template <typename Real, Formula F, uint32_t MaxIter, typename Count>
+__global__ void escape_time_gpu(PixelGrid grid, const int *pixels, double cr, double ci, Count *bitmap, Count *period, int NPIXEL, FractalParams params)
 {
     int id = blockDim.x * blockIdx.x + threadIdx.x;
     if (id < NPIXEL)
     {
-        // complex_d c{cr[id], ci[id]};
-        double x0 = cr;
-        double y0 = ci;
-
-        double escape_radios = 2.0;
-        // complex_d n = c;
-        int i = 0;
-        double x = xr[id];
-        double y = xi[id];
-
-        double x2 = x * x;
-        double y2 = y * y;
-        double w = 0.0;
+        int pixel = pixels ? pixels[id] : id;
+        uint32_t p = 0;
+        bitmap[id] = Count(escape_time<Real, F, MaxIter>(Real(grid.x(pixel)), Real(grid.y(pixel)), Real(cr), Real(ci), params, &p));
+        if (period)
+        {
+            period[id] = Count(p);
+        }
+    }
+}
 
-        while (x2 + y2 <= 4 && i < MAX_ITERATION)
+// Launch the kernel compiled for params, or the runtime-parameter one.
+// pixels is a device array.
+template <Formula F, typename Count>
+void launch_escape_time_gpu(const PixelGrid &grid, const int *pixels, double cr, double ci, Count *bitmap, Count *period, int NPIXEL, const FractalParams &params, Precision precision)
+{
+    int thread_n = GPU_THREAD_N;
+    int block_n = (NPIXEL + thread_n - 1) / thread_n;
+    with_iteration_cap(params, [&](auto max_iter) {
+        if (precision == Precision::float32)
+        {
+            hipLaunchKernelGGL(HIP_KERNEL_NAME(escape_time_gpu<float, F, decltype(max_iter)::value, Count>), block_n, thread_n, 0, 0, grid, pixels, cr, ci, bitmap, period, NPIXEL, params);
+        }
+        else
         {
-            double xtemp = x2 - y2;
-            y = 2 * x * y + y0;
-            x = xtemp + x0;
-            x2 = x * x;
-            y2 = y * y;
-            ++i;
+            hipLaunchKernelGGL(HIP_KERNEL_NAME(escape_time_gpu<double, F, decltype(max_iter)::value, Count>), block_n, thread_n, 0, 0, grid, pixels, cr, ci, bitmap, period, NPIXEL, params);
         }
+    });
+}
 
-        bitmap[id] = i;
+// Grid version of escape_time_gpu for number types that do not fit in a
+// double, pixel id sits at (id % width, id / width). The
+// coordinates are built the same way as in escape_time_grid().
+template <typename Real, Formula F, uint32_t MaxIter, typename Count>
+__global__ void escape_time_grid_gpu(Real x0, Real y0, double step, Real cr, Real ci, Count *bitmap, Count *period, int width, int NPIXEL, FractalParams params)
+{
+    int id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id < NPIXEL)
+    {
+        Real px = x0 + Real(id % width * step);
+        Real py = y0 + Real(id / width * step);
+        uint32_t p = 0;
+        bitmap[id] = Count(escape_time<Real, F, MaxIter>(px, py, cr, ci, params, &p));
+        if (period)
+        {
+            period[id] = Count(p);
+        }
     }
 }
 
-void output_image(int **bitmap, int length, int height)
+template <typename Real, Formula F, typename Count>
+void launch_escape_time_grid_gpu(Real x0, Real y0, double step, Real cr, Real ci, Count *bitmap, Count *period, int width, int NPIXEL, const FractalParams &params)
 {
-    std::ofstream image;
-    image.open("image.bpm");
+    int thread_n = GPU_THREAD_N;
+    int block_n = (NPIXEL + thread_n - 1) / thread_n;
+    with_iteration_cap(params, [&](auto max_iter) {
+        hipLaunchKernelGGL(HIP_KERNEL_NAME(escape_time_grid_gpu<Real, F, decltype(max_iter)::value, Count>), block_n, thread_n, 0, 0, x0, y0, step, cr, ci, bitmap, period, width, NPIXEL, params);
+    });
+}
+
+// Interior colors, indexed by the period of the attracting cycle
+const olc::Pixel PERIOD_PALETTE[] = {
+    olc::Pixel(40, 40, 120), olc::Pixel(40, 120, 40), olc::Pixel(120, 40, 40), olc::Pixel(120, 120, 40),
+    olc::Pixel(40, 120, 120), olc::Pixel(120, 40, 120), olc::Pixel(200, 120, 40), olc::Pixel(40, 200, 120),
+};
+
+// Writes a view as a plain PGM image, in the grey levels it is shaded with
+// on screen: counts scaled to the cap of the frame they hold
+template <typename Count>
+void output_image(const std::string &filename, const Count *bitmap, int width, int height, uint32_t max_iteration)
+{
+    std::ofstream image(filename);
     image << "P2\n";
-    image << length << " " << height << "\n";
-    image << 20 << "\n";
+    image << width << " " << height << "\n";
+    image << 255 << "\n";
 
     for (int y = 0; y < height; y++)
     {
-        for (int x = 0; x < length; x++)
+        for (int x = 0; x < width; x++)
         {
-            image << (MAX_ITERATION - bitmap[x][y]) / 10 << " ";
+            image << bitmap[width * y + x] * uint64_t(255) / max_iteration << " ";
         }
         image << "\n";
     }
-
-    image.close();
 }
 
 class MandelbrotDisplay : public olc::PixelGameEngine
 {
 public:
-    MandelbrotDisplay(int32_t height, int32_t width) : height(height), width(width)
+    MandelbrotDisplay(int32_t height, int32_t width, FractalParams params, unsigned thread_n) : height(height), width(width), params(params), pool(thread_n), tile_cache(TILE_CACHE_MB << 20)
     {
         sAppName = "Mandelbrot Display";
+        fmt::print("render threads: {}\n", pool.size());
         NPIXEL = this->width * this->height;
+        shift_x = snap_to_lattice(shift_x, range / width);
+        shift_y = snap_to_lattice(shift_y, range / width);
         // hipFree(NULL);
 
-        bitmap_size = width * height * sizeof(int);
-        cmap_size = width * height * sizeof(double);
+        mandelbrot_counts.allocate(NPIXEL);
+        julia_counts.allocate(NPIXEL);
 
-        bitmapMandelbrot = (int *)malloc(bitmap_size);
-        bitmapJulia = (int *)malloc(bitmap_size);
+        if (GPU_CALC)
+        {
+            auto result = hipMalloc(&mandelbrot_result_gpu, NPIXEL * sizeof(uint32_t));
+            result = hipMalloc(&period_result_gpu, NPIXEL * sizeof(uint32_t));
+        }
 
-        cmap_i_host = (double *)malloc(cmap_size);
-        cmap_r_host = (double *)malloc(cmap_size);
+        // pixel lists of the progressive passes, and the single pass over
+        // every pixel
+        all_pixels.resize(NPIXEL);
+        std::iota(all_pixels.begin(), all_pixels.end(), 0);
+        all_pixel_passes = {all_pixels};
+        for (size_t pass = 0; pass < std::size(PROGRESSIVE_STRIDES); pass++)
+        {
+            int stride = PROGRESSIVE_STRIDES[pass];
+            std::vector<int> pixels;
+            for (int i = 0; i < NPIXEL; i++)
+            {
+                int x = i % width, y = i / width;
+                bool on_lattice = x % stride == 0 && y % stride == 0;
+                bool done = pass > 0 && x % (2 * stride) == 0 && y % (2 * stride) == 0;
+                if (on_lattice && !done)
+                {
+                    pixels.push_back(i);
+                }
+            }
+            progressive_passes.push_back(std::move(pixels));
+        }
+        packed_counts.allocate(NPIXEL);
+        skip_pixels.resize(NPIXEL);
+        // the julia view never moves
+        julia_axes.fill(julia_grid(range / width), height);
+
+        // Julia sets are symmetric under z -> -z, and the julia view is
+        // centered on the origin: a pixel below the middle row is the
+        // rotation of pixel (2 * center_x - x, 2 * center_y - y) if that is
+        // in view
+        julia_rotated.resize(NPIXEL);
+        for (int i = 0; i < NPIXEL; i++)
+        {
+            int x = i % width, y = i / width;
+            julia_rotated[i] = y > height / 2 && 2 * (width / 2) - x < width && 2 * (height / 2) - y < height;
+            if (!julia_rotated[i])
+            {
+                julia_pixels.push_back(i);
+            }
+        }
+        if (GPU_CALC)
+        {
+            auto result = hipMalloc(&julia_pixels_device, julia_pixels.size() * sizeof(int));
+            result = hipMemcpy(julia_pixels_device, julia_pixels.data(), julia_pixels.size() * sizeof(int), hipMemcpyHostToDevice);
+        }
 
-        auto result = hipMalloc(&cmap_i_device, cmap_size);
-        result = hipMalloc(&cmap_r_device, cmap_size);
+        if (GPU_CALC)
+        {
+            gen_image_mandelbrot(mandelbrot_frame());
+            gen_image_julia(julia_frame(0, 0));
+        }
+        else
+        {
+            screen_copy.resize(NPIXEL);
+            mandelbrot_shown.allocate(NPIXEL);
+            julia_shown.allocate(NPIXEL);
+            screen_frame = mandelbrot_frame();
+            // the CPU path renders in the background, the first frames are
+            // drawn tile by tile as they finish
+            if (!BENCHMARK)
+            {
+                render_thread = std::thread([this] { render_loop(); });
+                request_mandelbrot();
+                request_julia(julia_frame(0, 0));
+            }
+        }
+        Construct(width * 2, height, 1, 1);
+    }
 
-        result = hipMalloc(&mandelbrot_result_gpu, bitmap_size);
+    ~MandelbrotDisplay()
+    {
+        if (render_thread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(render_mutex);
+                render_stopping = true;
+                // make the frame in progress stale, so it stops early
+                mandelbrot_generation++;
+                julia_generation++;
+            }
+            render_wake.notify_one();
+            render_thread.join();
+        }
+    }
 
-        gen_image_mandelbrot(bitmapMandelbrot, width, height, zoom);
-        gen_image_julia(bitmapJulia, width, height, 0, 0);
-        Construct(width * 2, height, 1, 1);
+    // --bench: times each stage of a CPU frame of the start view, best of
+    // BENCH_RUNS, with the bandwidth of the memory it reads and writes. The
+    // stages that walk the per-pixel arrays of a view also run column by
+    // column, x in the outer loop as the render loops used to, as a
+    // baseline for the row order they use now.
+    int benchmark()
+    {
+        const int BENCH_RUNS = 5;
+        olc::Sprite target(width * 2, height);
+        SetDrawTarget(&target);
+        auto time = [&](auto run) {
+            run();
+            double best = std::numeric_limits<double>::max();
+            for (int i = 0; i < BENCH_RUNS; i++)
+            {
+                auto start = rdsysns();
+                run();
+                best = std::min(best, (rdsysns() - start) / 1e6);
+            }
+            return best;
+        };
+        auto stage = [&](const char *name, double bytes, auto run) {
+            double best = time(run);
+            fmt::print("bench {:<20} {:9.2f} ms {:8.2f} GB/s\n", name, best, bytes / best / 1e6);
+        };
+        auto stage_layouts = [&](const char *name, double bytes, auto rows, auto columns) {
+            double best = time(rows);
+            double column_best = time(columns);
+            fmt::print("bench {:<20} {:9.2f} ms {:8.2f} GB/s, by columns {:9.2f} ms {:8.2f} GB/s, {:.1f}x\n", name, best, bytes / best / 1e6, column_best, bytes / column_best / 1e6, column_best / best);
+        };
+
+        MandelbrotFrame frame = mandelbrot_frame();
+        DoubleDouble step = range / width;
+        Precision precision = update_precision(mandelbrot_precision, params, double(step), mandelbrot_extent(frame, double(step)));
+        mandelbrot_counts.set_max_iteration(params.max_iteration);
+        julia_counts.set_max_iteration(params.max_iteration);
+        // bytes per count or period
+        double count_bytes = double(count_size(mandelbrot_counts.type()));
+        fmt::print("bench view {}x{}, precision {}, max_iteration {}, {} byte counts, {} threads\n", width, height, precision_name(precision), params.max_iteration, count_bytes, pool.size());
+
+        // coordinates alone, summed so they are not optimized away. The
+        // baseline is a coordinate map of the view filled column by column,
+        // as the cmap builders did.
+        std::mutex sum_mutex;
+        double coordinate_sum = 0.0;
+        std::vector<double> map_x(NPIXEL), map_y(NPIXEL);
+        stage_layouts("coordinates", NPIXEL * 2.0 * sizeof(double), [&] {
+            mandelbrot_axes.fill(mandelbrot_grid(frame, step), height);
+            pool.parallel_for(NPIXEL, CPU_TASK_PIXELS, [&](int begin, int end) {
+                double sum = 0.0;
+                grid_kernel(mandelbrot_axes, all_pixels.data() + begin, packed_counts.counts<uint32_t>() + begin, packed_counts.periods<uint32_t>() + begin, end - begin, [&](const double *cr, const double *ci, uint32_t *, uint32_t *, int count) {
+                    for (int k = 0; k < count; k++)
+                    {
+                        sum += cr[k] + ci[k];
+                    }
+                    return KernelStats{};
+                });
+                std::lock_guard<std::mutex> lock(sum_mutex);
+                coordinate_sum += sum;
+            });
+        }, [&] {
+            mandelbrot_axes.fill(mandelbrot_grid(frame, step), height);
+            pool.parallel_for(width, 16, [&](int begin, int end) {
+                for (int x = begin; x < end; x++)
+                {
+                    for (int y = 0; y < height; y++)
+                    {
+                        map_x[width * y + x] = mandelbrot_axes.x[x];
+                        map_y[width * y + x] = mandelbrot_axes.y[y];
+                    }
+                }
+            });
+        });
+        stage("mandelbrot kernels", NPIXEL * 2.0 * count_bytes, [&] {
+            mandelbrot_counts.visit([&](auto *bitmap, auto *period) {
+                mandelbrot_cpu(pool, mandelbrot_axes, all_pixels.data(), bitmap, period, NPIXEL, params, precision);
+            });
+        });
+        std::optional<LatticeOrigin> origin = lattice_origin(frame, step);
+        stage("tile cache store", NPIXEL * 2.0 * count_bytes, [&] {
+            tile_cache = TileCache(TILE_CACHE_MB << 20);
+            store_tiles(origin, frame, precision);
+        });
+        stage("tile cache load", NPIXEL * (2.0 * count_bytes + 1), [&] {
+            load_cached_tiles(origin, frame, precision);
+        });
+        std::fill(skip_pixels.begin(), skip_pixels.end(), 0);
+        int mirrored = mark_mirror_rows(origin);
+        stage_layouts("mirror rows", mirrored * 4.0 * count_bytes, [&] {
+            copy_mirror_rows();
+        }, [&] {
+            mandelbrot_counts.visit([&](auto *bitmap, auto *period) {
+                for (int x = 0; x < width; x++)
+                {
+                    for (int y = mirror.begin; y < mirror.end; y++)
+                    {
+                        int from = width * (mirror.sum - y) + x;
+                        bitmap[width * y + x] = bitmap[from];
+                        period[width * y + x] = period[from];
+                    }
+                }
+            });
+        });
+        stage_layouts("draw", NPIXEL * (2.0 * count_bytes + sizeof(olc::Pixel)), [&] {
+            draw_bitmap(0, mandelbrot_counts);
+        }, [&] {
+            olc::Pixel *screen = target.GetData();
+            uint32_t max_iteration = mandelbrot_counts.max_iteration();
+            mandelbrot_counts.visit([&](const auto *bitmap, const auto *period) {
+                pool.parallel_for(width, 16, [&](int begin, int end) {
+                    for (int x = begin; x < end; x++)
+                    {
+                        for (int y = 0; y < height; y++)
+                        {
+                            screen[target.width * y + x] = shade(bitmap[width * y + x], period[width * y + x], max_iteration);
+                        }
+                    }
+                });
+            });
+        });
+        MandelbrotFrame panned = frame;
+        panned.pan_x += 37;
+        panned.pan_y += 23;
+        stage("preview", NPIXEL * 3.0 * sizeof(olc::Pixel), [&] {
+            screen_frame = frame;
+            preview_mandelbrot(panned);
+        });
+
+        double julia_step = range / width;
+        complex_d c = {-0.8, 0.156};
+        Precision julia_precision_used = update_precision(julia_precision, params, julia_step, std::max(range / 2, std::abs(c)));
+        int n = int(julia_pixels.size());
+        stage("julia kernels", n * 2.0 * count_bytes, [&] {
+            julia_counts.visit([&](auto *bitmap, auto *) {
+                using Count = std::remove_pointer_t<decltype(bitmap)>;
+                julia_cpu(pool, julia_axes, julia_pixels.data(), c, packed_counts.counts<Count>(), packed_counts.periods<Count>(), n, params, julia_precision_used);
+            });
+        });
+        stage("julia scatter", n * 4.0 * count_bytes, [&] {
+            pool.parallel_for(n, CPU_TASK_PIXELS, [&](int begin, int end) {
+                scatter_julia(begin, end);
+            });
+        });
+        stage_layouts("julia rotate", (NPIXEL - n) * 4.0 * count_bytes, [&] {
+            rotate_julia();
+        }, [&] {
+            julia_counts.visit([&](auto *bitmap, auto *period) {
+                pool.parallel_for(width, 16, [&](int begin, int end) {
+                    for (int x = begin; x < end; x++)
+                    {
+                        for (int y = height / 2 + 1; y < height; y++)
+                        {
+                            if (julia_rotated[width * y + x])
+                            {
+                                int from = width * (2 * (height / 2) - y) + 2 * (width / 2) - x;
+                                bitmap[width * y + x] = bitmap[from];
+                                period[width * y + x] = period[from];
+                            }
+                        }
+                    }
+                });
+            });
+        });
+        fmt::print("bench coordinate sum {}, map {}\n", coordinate_sum, map_x[NPIXEL - 1] + map_y[NPIXEL - 1]);
+        return 0;
     }
 
 private:
+    // Everything a render needs from the view, copied when it is requested
+    // so the UI thread can go on changing the view while it runs
+    struct MandelbrotFrame
+    {
+        DoubleDouble zoom;
+        int level;
+        DoubleDouble shift_x;
+        DoubleDouble shift_y;
+        // whole pixels the view was dragged by since the last zoom
+        int64_t pan_x = 0;
+        int64_t pan_y = 0;
+        FractalParams params;
+        RenderMode mode;
+        uint64_t generation = 0;
+    };
+
+    struct JuliaFrame
+    {
+        complex_d c;
+        FractalParams params;
+        RenderMode mode;
+        uint64_t generation = 0;
+    };
+
+    // pixels of one view done by a background render, copied as they were
+    // when it finished them
+    struct FinishedTile
+    {
+        bool julia;
+        uint64_t generation;
+        CountSnapshot counts;
+    };
+
     bool OnUserCreate() override
     {
         // Called once at the start, so create things here
@@ -199,166 +780,202 @@ private:
 
     bool OnUserUpdate(float fElapsedTime) override
     {
-        double new_zoom = zoom;
+        int new_level = zoom_level;
         int32_t mouse_x = GetMouseX();
         int32_t mouse_y = GetMouseY();
         bool pan_shift = false;
 
-        if (GetMouse(0).bHeld)
+        if (GetMouse(0).bHeld && (mouse_x != mouse_x_old || mouse_y != mouse_y_old))
         {
-            // Pan
-            double x_shift_delta = double(mouse_x_old - mouse_x) / width * range / zoom;
-            double y_shift_delta = double(mouse_y_old - mouse_y) / height * range / zoom;
-
-            shift_x += x_shift_delta;
-            shift_y += y_shift_delta;
+            // Pan. The mouse moves by whole pixels and so does the view: the
+            // pixels still in it keep their exact coordinates, and only the
+            // uncovered ones need computing.
+            pan_x += mouse_x_old - mouse_x;
+            pan_y += mouse_y_old - mouse_y;
 
             pan_shift = true;
-            fmt::print("{},{}, c:{},{}, old{},{}\n", x_shift_delta, y_shift_delta, mouse_x, mouse_y, mouse_x_old, mouse_y_old);
+            fmt::print("pan {},{}, c:{},{}, old{},{}\n", pan_x, pan_y, mouse_x, mouse_y, mouse_x_old, mouse_y_old);
         }
 
         if (GetMouseWheel() > 0)
         {
             std::cout << "mouse up\n";
-            new_zoom = new_zoom * 1.25;
+            new_level++;
         }
-        else if (GetMouseWheel() < 0)
+        else if (GetMouseWheel() < 0 && new_level > 0)
         {
             std::cout << "mouse down\n";
-            new_zoom = new_zoom * 0.8;
-            if (new_zoom < 1.0)
-            {
-                new_zoom = 1;
-            }
+            new_level--;
+        }
+        DoubleDouble new_zoom = zoom_at_level(new_level);
+        // iteration cap, doubled or halved and kept at 2^n - 1
+        bool params_changed = false;
+        if (GetKey(olc::Key::PGUP).bPressed && params.max_iteration < (1u << 30))
+        {
+            params.max_iteration = params.max_iteration * 2 + 1;
+            params_changed = true;
         }
-        if (new_zoom != zoom || pan_shift)
+        else if (GetKey(olc::Key::PGDN).bPressed && params.max_iteration > 1)
         {
+            params.max_iteration = params.max_iteration / 2;
+            params_changed = true;
+        }
+        if (params_changed)
+        {
+            fmt::print("max iteration {}\n", params.max_iteration);
+        }
 
-            fmt::print("mouse position {} {}\n", mouse_x, mouse_y);
-            fmt::print("zoom change from {} to {}\n", zoom, new_zoom);
+        // color interior points by the period of their cycle
+        bool recolor = false;
+        if (GetKey(olc::Key::P).bPressed)
+        {
+            color_period = !color_period;
+            recolor = true;
+            fmt::print("period coloring {}\n", color_period ? "on" : "off");
+        }
 
-            double px = double(mouse_x) / width - 0.5;
-            double py = double(mouse_y) / height - 0.5;
+        // both views as they are on screen, to mandelbrot.pgm and julia.pgm
+        if (GetKey(olc::Key::S).bPressed)
+        {
+            save_view("mandelbrot.pgm", GPU_CALC ? mandelbrot_counts : mandelbrot_shown);
+            save_view("julia.pgm", GPU_CALC ? julia_counts : julia_shown);
+        }
 
-            double old_distance_x = range / zoom * px;
-            double new_distance_x = old_distance_x * zoom / new_zoom;
+        // renderer of the CPU path
+        bool mode_changed = false;
+        if (GetKey(olc::Key::M).bPressed)
+        {
+            render_mode = RenderMode((int(render_mode) + 1) % 3);
+            mode_changed = true;
+            fmt::print("renderer {}\n", render_mode_name(render_mode));
+        }
 
-            double old_distance_y = range / zoom * py;
-            double new_distance_y = old_distance_y * zoom / new_zoom;
+        if (new_zoom != zoom || pan_shift || params_changed || mode_changed)
+        {
+            bool view_moved = new_zoom != zoom || pan_shift;
 
-            double add_shift_x = old_distance_x - new_distance_x;
-            double add_shift_y = old_distance_y - new_distance_y;
+            fmt::print("mouse position {} {}\n", mouse_x, mouse_y);
+            fmt::print("zoom change from {} to {}\n", double(zoom), double(new_zoom));
 
-            shift_x += add_shift_x;
-            shift_y += add_shift_y;
+            if (new_zoom != zoom)
+            {
+                // a zoom moves every pixel, the pan goes into the shift
+                DoubleDouble old_step = range / width / zoom;
+                shift_x += double(pan_x) * old_step;
+                shift_y += double(pan_y) * old_step;
+                pan_x = 0;
+                pan_y = 0;
 
-            int center_x = width / 2;
-            int center_y = height / 2;
+                double px = double(mouse_x) / width - 0.5;
+                double py = double(mouse_y) / height - 0.5;
 
-            double step = range / width / new_zoom;
+                DoubleDouble old_distance_x = range / zoom * px;
+                DoubleDouble new_distance_x = old_distance_x * zoom / new_zoom;
 
-            for (int x = 0; x < width; x++)
-            {
-                double x_d = (x - center_x) * step + shift_x;
-                for (int y = 0; y < height; y++)
-                {
-                    double y_d = (y - center_y) * step + shift_y;
-                    cmap_r_host[width * y + x] = x_d;
-                    cmap_i_host[width * y + x] = y_d;
-                }
+                DoubleDouble old_distance_y = range / zoom * py;
+                DoubleDouble new_distance_y = old_distance_y * zoom / new_zoom;
+
+                DoubleDouble add_shift_x = old_distance_x - new_distance_x;
+                DoubleDouble add_shift_y = old_distance_y - new_distance_y;
+
+                shift_x += add_shift_x;
+                shift_y += add_shift_y;
             }
 
+            DoubleDouble step = range / width / new_zoom;
+            // keeps the view on its level's lattice, for the tile cache
+            shift_x = snap_to_lattice(shift_x, step);
+            shift_y = snap_to_lattice(shift_y, step);
+
             if (GPU_CALC)
             {
-                // construct CMAP
-                fmt::print("gpu draw mandelbrot, step{} \n", step);
-                auto result = hipMemcpy(cmap_i_device, cmap_i_host, cmap_size, hipMemcpyHostToDevice);
-                result = hipMemcpy(cmap_r_device, cmap_r_host, cmap_size, hipMemcpyHostToDevice);
-
-                int thread_n = 256;
-                int block_n = (NPIXEL + 256 - 1) / 256;
-
-                hipLaunchKernelGGL(mandelbrot_gpu, block_n, thread_n, 0, 0, cmap_r_device, cmap_i_device, mandelbrot_result_gpu, NPIXEL);
+                Precision precision = update_precision(mandelbrot_precision, params, double(step), mandelbrot_extent(mandelbrot_frame(), double(step)));
+                fmt::print("gpu draw mandelbrot, step{}, precision {} \n", double(step), precision_name(precision));
+                hipError_t result;
+                DoubleDouble x0 = mandelbrot_x(mandelbrot_frame(), step, 0);
+                DoubleDouble y0 = mandelbrot_y(mandelbrot_frame(), step, 0);
+                mandelbrot_counts.set_max_iteration(params.max_iteration);
+                mandelbrot_counts.visit([&](auto *bitmap, auto *period) {
+                    using Count = std::remove_pointer_t<decltype(bitmap)>;
+                    Count *bitmap_gpu = static_cast<Count *>(mandelbrot_result_gpu);
+                    Count *period_gpu = static_cast<Count *>(period_result_gpu);
+                    if (precision == Precision::double_double)
+                    {
+                        launch_escape_time_grid_gpu<DoubleDouble, Formula::mandelbrot>(x0, y0, double(step), 0.0, 0.0, bitmap_gpu, period_gpu, width, NPIXEL, params);
+                    }
+                    else if (precision == Precision::fixed64)
+                    {
+                        launch_escape_time_grid_gpu<Fixed64, Formula::mandelbrot>(x0, y0, double(step), 0.0, 0.0, bitmap_gpu, period_gpu, width, NPIXEL, params);
+                    }
+                    else if (precision == Precision::fixed128)
+                    {
+                        launch_escape_time_grid_gpu<Fixed128, Formula::mandelbrot>(x0, y0, double(step), 0.0, 0.0, bitmap_gpu, period_gpu, width, NPIXEL, params);
+                    }
+                    else
+                    {
+                        launch_escape_time_gpu<Formula::mandelbrot>(mandelbrot_grid(mandelbrot_frame(), step), nullptr, 0.0, 0.0, bitmap_gpu, period_gpu, NPIXEL, params, precision);
+                    }
 
-                result = hipMemcpy(bitmapMandelbrot, mandelbrot_result_gpu, bitmap_size, hipMemcpyDeviceToHost);
+                    result = hipMemcpy(bitmap, bitmap_gpu, NPIXEL * sizeof(Count), hipMemcpyDeviceToHost);
+                    result = hipMemcpy(period, period_gpu, NPIXEL * sizeof(Count), hipMemcpyDeviceToHost);
+                });
+            }
+            zoom = new_zoom;
+            zoom_level = new_level;
+            if (GPU_CALC)
+            {
+                should_draw = true;
             }
             else
             {
-                // use the old bitmap to do interpolation
-                // while calculating the new bitmap
-                // gen_image_mandelbrot(bitmapMandelbrot, width, height, new_zoom);
-                fmt::print("cpu draw, step{} \n", step);
-                for (int i = 0; i < NPIXEL; i++)
+                // the old image, moved to the new view, stays up until the
+                // tiles of the new one replace it
+                fmt::print("cpu draw, step{} \n", double(step));
+                if (view_moved)
                 {
-                    complex_d c{cmap_r_host[i], cmap_i_host[i]};
-                    uint32_t r = mandelbrot(c);
-                    bitmapMandelbrot[i] = r;
+                    preview_mandelbrot(mandelbrot_frame());
                 }
+                request_mandelbrot();
             }
-
-            zoom = new_zoom;
-            should_draw = true;
             // DrawString(30, 30, std::to_string(new_zoom));
         }
 
-        if (mouse_x != mouse_x_old || mouse_y != mouse_y_old)
+        if (mouse_x != mouse_x_old || mouse_y != mouse_y_old || params_changed || recolor || mode_changed)
         {
             if (GPU_CALC)
             {
-
-                int center_x = width / 2;
-                int center_y = height / 2;
-
-                double step = range / width / zoom;
-                double c_x = (mouse_x - center_x) * step + shift_x;
-                double c_y = (mouse_y - center_y) * step + shift_y;
+                DoubleDouble step = range / width / zoom;
+                double c_x = double(mandelbrot_x(mandelbrot_frame(), step, mouse_x));
+                double c_y = double(mandelbrot_y(mandelbrot_frame(), step, mouse_y));
 
                 double julia_step = range / width;
-                for (int x = 0; x < width; x++)
-                {
-                    double x_d = (x - center_x) * julia_step;
-                    for (int y = 0; y < height; y++)
-                    {
-                        double y_d = (y - center_y) * julia_step;
-
-                        cmap_r_host[width * y + x] = x_d;
-                        cmap_i_host[width * y + x] = y_d;
-                    }
-                }
-
-                auto result = hipMemcpy(cmap_i_device, cmap_i_host, cmap_size, hipMemcpyHostToDevice);
-                result = hipMemcpy(cmap_r_device, cmap_r_host, cmap_size, hipMemcpyHostToDevice);
 
-                int thread_n = 256;
-                int block_n = (NPIXEL + 256 - 1) / 256;
+                // only the pixels that are not rotations of others
+                int n = int(julia_pixels.size());
 
-                // fmt::print("gpu draw julia, block_n:{}, step:{}, c_x:{}, c_y:{} \n", block_n, julia_step, c_x, c_y);
+                // fmt::print("gpu draw julia, step:{}, c_x:{}, c_y:{} \n", julia_step, c_x, c_y);
 
-                hipLaunchKernelGGL(julia_gpu, block_n, thread_n, 0, 0, cmap_r_device, cmap_i_device, c_x, c_y, mandelbrot_result_gpu, NPIXEL);
+                Precision precision = update_precision(julia_precision, params, julia_step, std::max(range / 2, std::abs(complex_d{c_x, c_y})));
+                julia_counts.set_max_iteration(params.max_iteration);
+                julia_counts.visit([&](auto *bitmap, auto *) {
+                    using Count = std::remove_pointer_t<decltype(bitmap)>;
+                    Count *bitmap_gpu = static_cast<Count *>(mandelbrot_result_gpu);
+                    Count *period_gpu = static_cast<Count *>(period_result_gpu);
+                    launch_escape_time_gpu<Formula::julia>(julia_grid(julia_step), julia_pixels_device, c_x, c_y, bitmap_gpu, period_gpu, n, params, precision);
 
-                result = hipMemcpy(bitmapJulia, mandelbrot_result_gpu, bitmap_size, hipMemcpyDeviceToHost);
+                    auto result = hipMemcpy(packed_counts.counts<Count>(), bitmap_gpu, n * sizeof(Count), hipMemcpyDeviceToHost);
+                    result = hipMemcpy(packed_counts.periods<Count>(), period_gpu, n * sizeof(Count), hipMemcpyDeviceToHost);
+                });
+                pool.parallel_for(n, CPU_TASK_PIXELS, [&](int begin, int end) {
+                    scatter_julia(begin, end);
+                });
+                rotate_julia();
 
-                for (int x = 0; x < width; x++)
-                {
-                    for (int y = 0; y < height; y++)
-                    {
-                        int value = bitmapJulia[width * y + x];
-                        Draw(x + width, y, olc::Pixel(value, value, value));
-                    }
-                }
+                draw_bitmap(width, julia_counts);
             }
             else
             {
-                gen_image_julia(bitmapJulia, width, height, mouse_x, mouse_y);
-                // fmt::print("redraw julia");
-                for (int x = 0; x < width; x++)
-                {
-                    for (int y = 0; y < height; y++)
-                    {
-                        int value = bitmapJulia[width * y + x];
-                        Draw(x + width, y, olc::Pixel(value, value, value));
-                    }
-                }
+                request_julia(julia_frame(mouse_x, mouse_y));
             }
         }
 
@@ -366,21 +983,25 @@ private:
         mouse_y_old = mouse_y;
 
         // called once per frame
-        if (should_draw)
+        if (GPU_CALC && (should_draw || recolor))
         {
 
-            std::cout << "redraw with zoom:" << zoom << "\n";
-            for (int x = 0; x < width; x++)
-            {
-                for (int y = 0; y < height; y++)
-                {
-                    int value = bitmapMandelbrot[width * y + x];
-                    Draw(x, y, olc::Pixel(value, value, value));
-                }
-            }
+            std::cout << "redraw with zoom:" << double(zoom) << "\n";
+            draw_bitmap(0, mandelbrot_counts);
 
             should_draw = false;
         }
+        if (!GPU_CALC)
+        {
+            // The pool and the count buffers belong to the render thread,
+            // so the UI thread shades its own copies, and only what changed
+            if (recolor)
+            {
+                draw_pixels(0, mandelbrot_shown, 0, NPIXEL);
+                draw_pixels(width, julia_shown, 0, NPIXEL);
+            }
+            draw_finished_tiles();
+        }
 
         // for (int i = 0; i < 100; i++)
         // {
@@ -390,112 +1011,1551 @@ private:
         return true;
     }
 
-    void gen_image_julia(int *bitmap, int width, int height, int x, int y)
+    // grey level scaled to the iteration cap of the frame on screen, or the
+    // period color for interior points when period coloring is on
+    olc::Pixel shade(uint32_t value, uint32_t period, uint32_t max_iteration)
     {
-        // compute c with regard to mandelbrot set
-        int center_x = width / 2;
-        int center_y = height / 2;
-
-        double step = range / width / zoom;
-        double c_x = (x - center_x) * step + shift_x;
-        double c_y = (y - center_y) * step + shift_y;
-        complex_d c{c_x, c_y};
-
-        // reset step for julia generation
-        step = range / width;
-
-        for (int x = 0; x < width; x++)
+        if (color_period && period > 0)
         {
-            double x_d = (x - center_x) * step;
-            for (int y = 0; y < height; y++)
-            {
-                double y_d = (y - center_y) * step;
-                complex_d v{x_d, y_d};
-                uint32_t r = julia(v, c);
-                bitmap[width * y + x] = r;
-            }
+            return PERIOD_PALETTE[(period - 1) % std::size(PERIOD_PALETTE)];
         }
+        uint8_t v = uint8_t(value * uint64_t(255) / max_iteration);
+        return olc::Pixel(v, v, v);
     }
 
-    void gen_image_mandelbrot(int *bitmap, int length, int height, double zoom)
+    void save_view(const std::string &filename, const CountBuffers &counts)
     {
-        total_power_count = 0;
-        auto start = rdsysns();
-
-        int center_x = length / 2;
-        int center_y = height / 2;
-
-        double step = range / length / zoom;
+        counts.visit([&](const auto *bitmap, const auto *) {
+            output_image(filename, bitmap, width, height, counts.max_iteration());
+        });
+        fmt::print("saved {}\n", filename);
+    }
 
-        memset(cmap_r_host, 0, length * height * sizeof(double));
-        for (int x = 0; x < length; x++)
-        {
-            double x_d = (x - center_x) * step + shift_x;
-            for (int y = 0; y < height; y++)
+    // Shades pixels [begin, end) of one view into the screen at column
+    // x_offset. Writes the draw target a row at a time rather than through
+    // Draw(), which checks every pixel against the target.
+    void draw_pixels(int x_offset, const CountBuffers &counts, int begin, int end)
+    {
+        olc::Sprite *target = GetDrawTarget();
+        olc::Pixel *screen = target->GetData();
+        uint32_t max_iteration = counts.max_iteration();
+        counts.visit([&](const auto *bitmap, const auto *period) {
+            for (int i = begin; i < end;)
             {
-                double y_d = (y - center_y) * step + shift_y;
-                cmap_r_host[length * y + x] = x_d;
-                cmap_i_host[length * y + x] = y_d;
-                if (x == 0 || x == 1)
+                int y = i / width;
+                int row_end = std::min(end, width * (y + 1));
+                olc::Pixel *row = screen + target->width * y + x_offset - width * y;
+                for (; i < row_end; i++)
                 {
-                    fmt::print("x:{} y:{} i:{} v:{}\n", x, y, x * y + x, x_d);
+                    row[i] = shade(bitmap[i], period[i], max_iteration);
                 }
             }
-        }
+        });
+    }
 
-        // save_to_csv(cmap_r_host, "cmap_r_host", length, height);
+    // Whole view. Every row is its own pixels of the draw target, so rows go
+    // to the pool.
+    void draw_bitmap(int x_offset, const CountBuffers &counts)
+    {
+        pool.parallel_for(height, 16, [&](int begin, int end) {
+            draw_pixels(x_offset, counts, begin * width, end * width);
+        });
+    }
 
-        for (int x = 0; x < length; x++)
+    // Zoom or pan preview: redraws the mandelbrot view on screen as frame,
+    // resampled from what it shows of screen_frame, so a new view is up on
+    // the next frame. Parts the old view did not cover are black. The
+    // render's tiles replace it as they finish.
+    void preview_mandelbrot(const MandelbrotFrame &frame)
+    {
+        DoubleDouble old_step = range / width / screen_frame.zoom;
+        DoubleDouble new_step = range / width / frame.zoom;
+        // pixel (x, y) of frame is at (x0 + x * scale, y0 + y * scale) on
+        // the old view's pixel grid
+        double scale = double(new_step / old_step);
+        double x0 = double((mandelbrot_x(frame, new_step, 0) - mandelbrot_x(screen_frame, old_step, 0)) / old_step);
+        double y0 = double((mandelbrot_y(frame, new_step, 0) - mandelbrot_y(screen_frame, old_step, 0)) / old_step);
+
+        // nearest old column and row of every new one, -1 where there is none
+        auto nearest = [&](double origin, int n) {
+            std::vector<int> index(n);
+            for (int i = 0; i < n; i++)
+            {
+                double at = std::floor(origin + i * scale + 0.5);
+                index[i] = at >= 0.0 && at < n ? int(at) : -1;
+            }
+            return index;
+        };
+        std::vector<int> columns = nearest(x0, width);
+        std::vector<int> rows = nearest(y0, height);
+
+        // the view is the left half of the draw target, written directly:
+        // per-pixel Draw() calls would take several frames
+        olc::Pixel *screen = GetDrawTarget()->GetData();
+        int stride = ScreenWidth();
+        for (int y = 0; y < height; y++)
+        {
+            std::copy(screen + stride * y, screen + stride * y + width, screen_copy.begin() + width * y);
+        }
+        for (int y = 0; y < height; y++)
         {
-            // double x_d = (x - center_x) * step + shift_x;
-            for (int y = 0; y < height; y++)
+            olc::Pixel *row = screen + stride * y;
+            if (rows[y] < 0)
             {
-                // double y_d = (y - center_y) * step + shift_y;
-                double x_d = cmap_r_host[length * y + x];
-                double y_d = cmap_i_host[length * y + x];
-                complex_d v{x_d, y_d};
-                uint32_t r = mandelbrot(v);
-                bitmap[length * y + x] = r;
+                std::fill(row, row + width, olc::BLACK);
+                continue;
+            }
+            const olc::Pixel *from = screen_copy.data() + width * rows[y];
+            for (int x = 0; x < width; x++)
+            {
+                row[x] = columns[x] < 0 ? olc::BLACK : from[columns[x]];
             }
         }
+        screen_frame = frame;
+    }
+
+    // Stores and draws the tiles the render thread finished since the last
+    // frame, skipping the ones of a frame that has been replaced since
+    void draw_finished_tiles()
+    {
+        std::vector<FinishedTile> tiles;
+        {
+            std::lock_guard<std::mutex> lock(tile_mutex);
+            tiles.swap(finished_tiles);
+        }
+        for (const FinishedTile &tile : tiles)
+        {
+            if (tile.julia && tile.generation == julia_generation)
+            {
+                julia_shown.store(tile.counts);
+                draw_pixels(width, julia_shown, tile.counts.begin, tile.counts.end);
+            }
+            else if (!tile.julia && tile.generation == mandelbrot_generation)
+            {
+                mandelbrot_shown.store(tile.counts);
+                draw_pixels(0, mandelbrot_shown, tile.counts.begin, tile.counts.end);
+            }
+        }
+    }
+
+    MandelbrotFrame mandelbrot_frame()
+    {
+        return {zoom, zoom_level, shift_x, shift_y, pan_x, pan_y, params, render_mode};
+    }
+
+    // coordinates of column x and row y of the mandelbrot view
+    DoubleDouble mandelbrot_x(const MandelbrotFrame &frame, DoubleDouble step, int64_t x)
+    {
+        return double(x + frame.pan_x - width / 2) * step + frame.shift_x;
+    }
+
+    DoubleDouble mandelbrot_y(const MandelbrotFrame &frame, DoubleDouble step, int64_t y)
+    {
+        return double(y + frame.pan_y - height / 2) * step + frame.shift_y;
+    }
+
+    // julia set for the c under the mouse at (x, y) in the mandelbrot view
+    // pixel coordinates of the frame, as mandelbrot_x() and mandelbrot_y()
+    PixelGrid mandelbrot_grid(const MandelbrotFrame &frame, DoubleDouble step)
+    {
+        return {frame.shift_x, frame.shift_y, step, frame.pan_x - width / 2, frame.pan_y - height / 2, width};
+    }
+
+    // the julia view, centered on the origin
+    PixelGrid julia_grid(double step)
+    {
+        return {0.0, 0.0, step, -(width / 2), -(height / 2), width};
+    }
+
+    JuliaFrame julia_frame(int x, int y)
+    {
+        DoubleDouble mandelbrot_step = range / width / zoom;
+        double c_x = double(mandelbrot_x(mandelbrot_frame(), mandelbrot_step, x));
+        double c_y = double(mandelbrot_y(mandelbrot_frame(), mandelbrot_step, y));
+        return {{c_x, c_y}, params, render_mode};
+    }
+
+    // Hand the current view to the render thread as a new generation. A
+    // request it has not picked up yet is replaced, one in progress turns
+    // stale and stops at its next task.
+    void request_mandelbrot()
+    {
+        std::lock_guard<std::mutex> lock(render_mutex);
+        mandelbrot_request = mandelbrot_frame();
+        mandelbrot_request->generation = ++mandelbrot_generation;
+        render_wake.notify_one();
+    }
+
+    void request_julia(const JuliaFrame &frame)
+    {
+        std::lock_guard<std::mutex> lock(render_mutex);
+        julia_request = frame;
+        julia_request->generation = ++julia_generation;
+        render_wake.notify_one();
+    }
+
+    // Render thread: takes the newest request of each view and renders it on
+    // the pool, reporting every finished tile to the UI thread
+    void render_loop()
+    {
+        while (true)
+        {
+            std::optional<MandelbrotFrame> mandelbrot;
+            std::optional<JuliaFrame> julia;
+            {
+                std::unique_lock<std::mutex> lock(render_mutex);
+                render_wake.wait(lock, [&] { return render_stopping || mandelbrot_request || julia_request; });
+                if (render_stopping)
+                {
+                    return;
+                }
+                mandelbrot.swap(mandelbrot_request);
+                julia.swap(julia_request);
+            }
+            if (mandelbrot)
+            {
+                gen_image_mandelbrot(*mandelbrot, render_job(false, mandelbrot->generation));
+            }
+            if (julia)
+            {
+                gen_image_julia(*julia, render_job(true, julia->generation));
+            }
+        }
+    }
+
+    RenderJob render_job(bool julia, uint64_t generation)
+    {
+        RenderJob job;
+        job.generation = {julia ? &julia_generation : &mandelbrot_generation, generation};
+        // The tiles of a render are disjoint and never written again once
+        // done, so the copy can be made on the worker thread
+        job.tile_done = [this, julia, generation](int begin, int end) {
+            CountSnapshot counts = (julia ? julia_counts : mandelbrot_counts).snapshot(begin, end);
+            std::lock_guard<std::mutex> lock(tile_mutex);
+            finished_tiles.push_back({julia, generation, std::move(counts)});
+        };
+        return job;
+    }
+
+    // Shows the pixels computed so far, on the lattice of a progressive
+    // pass, as stride x stride blocks. The lattice pixels and the ones that
+    // are not computed are left alone.
+    void fill_progressive_blocks(int stride)
+    {
+        mandelbrot_counts.visit([&](auto *bitmap, auto *period) {
+            pool.parallel_for(height, 16, [&](int begin, int end) {
+                for (int y = begin; y < end; y++)
+                {
+                    int row = width * (y - y % stride);
+                    for (int x = 0; x < width; x++)
+                    {
+                        if ((x % stride != 0 || y % stride != 0) && !skip_pixels[width * y + x])
+                        {
+                            int from = row + x - x % stride;
+                            bitmap[width * y + x] = bitmap[from];
+                            period[width * y + x] = period[from];
+                        }
+                    }
+                }
+            });
+        });
+    }
+
+    // packed results [begin, end) of julia_pixels to the julia bitmap
+    void scatter_julia(int begin, int end)
+    {
+        julia_counts.visit([&](auto *bitmap, auto *period) {
+            using Count = std::remove_pointer_t<decltype(bitmap)>;
+            const Count *packed_bitmap = packed_counts.counts<Count>();
+            const Count *packed_period = packed_counts.periods<Count>();
+            for (int k = begin; k < end; k++)
+            {
+                bitmap[julia_pixels[k]] = packed_bitmap[k];
+                period[julia_pixels[k]] = packed_period[k];
+            }
+        });
+    }
+
+    // Fills the rest of the julia view by rotating it about the origin. -z
+    // has the same orbit as z from the first iteration on, and the cycle
+    // detection only starts there (see escape_time()), so a rotated pixel is
+    // an exact copy of a computed one. Each rotated row is one reversed copy
+    // of the columns julia_rotated marks in it.
+    void rotate_julia()
+    {
+        int center_x = width / 2;
+        int center_y = height / 2;
+        int x_begin = std::max(0, 2 * center_x - width + 1);
+        int x_end = std::min(width, 2 * center_x + 1);
+        julia_counts.visit([&](auto *bitmap, auto *period) {
+            pool.parallel_for(height - center_y - 1, 16, [&](int begin, int end) {
+                for (int y = center_y + 1 + begin; y < center_y + 1 + end; y++)
+                {
+                    int to = width * y;
+                    int from = width * (2 * center_y - y) + 2 * center_x;
+                    std::reverse_copy(bitmap + from - (x_end - 1), bitmap + from - x_begin + 1, bitmap + to + x_begin);
+                    std::reverse_copy(period + from - (x_end - 1), period + from - x_begin + 1, period + to + x_begin);
+                }
+            });
+        });
+    }
+
+    // Computes the pixels that are not rotations of others, then rotates
+    void gen_image_julia(const JuliaFrame &frame, const RenderJob &job = {})
+    {
+        double step = range / width;
+        Precision precision = update_precision(julia_precision, frame.params, step, std::max(range / 2, std::abs(frame.c)));
+        julia_counts.set_max_iteration(frame.params.max_iteration);
+        if (frame.mode == RenderMode::boundary_trace)
+        {
+            julia_counts.visit([&](auto *bitmap, auto *period) {
+                using Count = std::remove_pointer_t<decltype(bitmap)>;
+                render_tiles(trace_tile<Count>, bitmap, period, job, "julia boundary trace", [&](const int *pixels, int n) {
+                    return compute_julia_pixels(frame, precision, pixels, n);
+                }, 0, 0, &julia_rotated);
+            });
+        }
+        else
+        {
+            RenderJob packed_job;
+            packed_job.generation = job.generation;
+            packed_job.tile_done = [&](int begin, int end) {
+                scatter_julia(begin, end);
+                if (job.tile_done && begin < end)
+                {
+                    job.tile_done(julia_pixels[begin], julia_pixels[end - 1] + 1);
+                }
+            };
+            julia_counts.visit([&](auto *bitmap, auto *) {
+                using Count = std::remove_pointer_t<decltype(bitmap)>;
+                julia_cpu(pool, julia_axes, julia_pixels.data(), frame.c, packed_counts.counts<Count>(), packed_counts.periods<Count>(), int(julia_pixels.size()), frame.params, precision, packed_job);
+            });
+        }
+        if (job.generation.stale())
+        {
+            return;
+        }
+        rotate_julia();
+        if (job.tile_done)
+        {
+            job.tile_done(width * (height / 2 + 1), NPIXEL);
+        }
+    }
+
+    void gen_image_mandelbrot(const MandelbrotFrame &frame, const RenderJob &job = {})
+    {
+        total_power_count = 0;
+        skipped_pixel_count = 0;
+        periodic_pixel_count = 0;
+        pool.reset_load();
+        auto start = rdsysns();
+
+        const FractalParams &params = frame.params;
+        DoubleDouble step = range / width / frame.zoom;
+        Precision precision = update_precision(mandelbrot_precision, params, double(step), mandelbrot_extent(frame, double(step)));
+        mandelbrot_axes.fill(mandelbrot_grid(frame, step), height);
+        // pixels reused from the last frame or the tile cache were computed
+        // with the same cap, so they are in this type already
+        mandelbrot_counts.set_max_iteration(params.max_iteration);
+
+        bool perturbation = precision == Precision::double_double && PERTURBATION && perturbation_supported(params);
+        auto compute = [&](const int *pixels, int n) { return compute_mandelbrot_pixels(frame, step, precision, pixels, n); };
+        // the bitmap stops holding the last frame as soon as it is written
+        std::optional<MandelbrotFrame> previous;
+        previous.swap(rendered_mandelbrot);
+        bool pan = previous && precision == rendered_precision && pan_reusable(*previous, frame);
+        std::optional<LatticeOrigin> origin = lattice_origin(frame, step);
+        int cached = 0, skipped = 0;
+        mirror = {};
+        if (!pan)
+        {
+            cached = load_cached_tiles(origin, frame, precision);
+            skipped = cached < NPIXEL ? cached + mark_mirror_rows(origin) : cached;
+        }
+        // tiles of the tile renderers line up with the cached ones
+        int tile_x = origin ? int((origin->x % RENDER_TILE + RENDER_TILE) % RENDER_TILE) : 0;
+        int tile_y = origin ? int((origin->y % RENDER_TILE + RENDER_TILE) % RENDER_TILE) : 0;
+        KernelStats stats;
+        if (pan)
+        {
+            stats = mandelbrot_counts.visit([&](auto *bitmap, auto *period) {
+                return render_pan(frame, *previous, step, precision, perturbation, job, bitmap, period);
+            });
+        }
+        else if (cached == NPIXEL)
+        {
+            if (job.tile_done)
+            {
+                job.tile_done(0, NPIXEL);
+            }
+        }
+        else if (frame.mode == RenderMode::subdivision && !perturbation)
+        {
+            stats = mandelbrot_counts.visit([&](auto *bitmap, auto *period) {
+                using Count = std::remove_pointer_t<decltype(bitmap)>;
+                return render_tiles(subdivide_tile<Count>, bitmap, period, job, "subdivision", compute, tile_x, tile_y, skipped ? &skip_pixels : nullptr);
+            });
+        }
+        else if (frame.mode == RenderMode::boundary_trace && !perturbation)
+        {
+            stats = mandelbrot_counts.visit([&](auto *bitmap, auto *period) {
+                using Count = std::remove_pointer_t<decltype(bitmap)>;
+                return render_tiles(trace_tile<Count>, bitmap, period, job, "boundary trace", compute, tile_x, tile_y, skipped ? &skip_pixels : nullptr);
+            });
+        }
+        else
+        {
+            mandelbrot_counts.visit([&](auto *bitmap, auto *period) {
+                render_passes(frame, step, precision, perturbation, job, skipped != 0, bitmap, period);
+            });
+        }
+        if (mirror.end > mirror.begin && !job.generation.stale())
+        {
+            copy_mirror_rows();
+            if (job.tile_done)
+            {
+                job.tile_done(width * mirror.begin, width * mirror.end);
+            }
+            fmt::print("mirrored rows {} to {}, {:.1f}%\n", mirror.begin, mirror.end - 1, 100.0 * (mirror.end - mirror.begin) / height);
+        }
+        total_power_count += stats.iterations;
+        skipped_pixel_count += stats.skipped;
+        periodic_pixel_count += stats.periodic;
 
         auto end = rdsysns();
 
-        should_draw = true;
         auto total_ns = end - start;
-        fmt::print("gen_image_mandelbrot, zoom {}, elapsed {}, total_power {}, ns_per_power {}\n", zoom, total_ns, total_power_count, total_ns / total_power_count);
+        if (job.generation.stale())
+        {
+            fmt::print("gen_image_mandelbrot, zoom {}, cancelled after {}\n", double(frame.zoom), total_ns);
+            return;
+        }
+        rendered_mandelbrot = frame;
+        rendered_precision = precision;
+        // Cached tiles are served as exact to every renderer, so only
+        // brute-force frames (perturbation always is) are stored:
+        // subdivision and boundary tracing fill areas with a uniform border
+        // without computing them. A perturbation pan puts the old pixels
+        // next to ones computed against other references, unlike a fresh
+        // render of the view.
+        bool brute_force = frame.mode == RenderMode::brute_force || perturbation;
+        if (brute_force && !(pan && perturbation))
+        {
+            store_tiles(origin, frame, precision);
+        }
+        fmt::print("gen_image_mandelbrot, zoom {}, precision {}, elapsed {}, total_power {}, ns_per_power {}, interior_skipped {}, periodic {}\n", double(frame.zoom), precision_name(precision), total_ns, total_power_count, total_ns / std::max<uint64_t>(total_power_count, 1), skipped_pixel_count, periodic_pixel_count);
+        print_thread_load();
     }
 
-    bool should_draw = true;
-    int *bitmapMandelbrot;
-    int *bitmapJulia;
-    int *mandelbrot_result_gpu;
+    // Brute force: every pixel, in progressive passes unless they are off.
+    // With skip, the pixels marked in skip_pixels are left out. bitmap and
+    // period are the mandelbrot view's, in its count type.
+    template <typename Count>
+    void render_passes(const MandelbrotFrame &frame, DoubleDouble step, Precision precision, bool perturbation, const RenderJob &job, bool skip, Count *bitmap, Count *period)
+    {
+        Count *packed_bitmap = packed_counts.counts<Count>();
+        Count *packed_period = packed_counts.periods<Count>();
+        auto start = rdsysns();
+        const FractalParams &params = frame.params;
+        DoubleDouble x0 = mandelbrot_x(frame, step, 0);
+        DoubleDouble y0 = mandelbrot_y(frame, step, 0);
+        std::vector<std::vector<int>> computed_passes;
+        if (skip)
+        {
+            for (const std::vector<int> &pass : PROGRESSIVE ? progressive_passes : all_pixel_passes)
+            {
+                computed_passes.emplace_back();
+                std::copy_if(pass.begin(), pass.end(), std::back_inserter(computed_passes.back()), [&](int i) { return !skip_pixels[i]; });
+            }
+        }
+        const std::vector<std::vector<int>> &passes = skip ? computed_passes : PROGRESSIVE ? progressive_passes : all_pixel_passes;
+        // the first reference orbit and its series serve every pass
+        std::optional<PerturbationReference> reference;
+        if (perturbation)
+        {
+            reference = perturbation_reference(x0, y0, double(step), width, height, params, SERIES_APPROXIMATION);
+        }
+        for (size_t pass = 0; pass < passes.size() && !job.generation.stale(); pass++)
+        {
+            const std::vector<int> &pixels = passes[pass];
+            int n = int(pixels.size());
+            bool last = pass + 1 == passes.size();
+
+            // The kernels write packed results, which go to the bitmap as
+            // their task finishes. Tasks of the last pass are final pixels
+            // and are drawn straight away; they cover every pixel between
+            // their first and last one that is not done already.
+            RenderJob pass_job;
+            pass_job.generation = job.generation;
+            pass_job.tile_done = [&](int begin, int end) {
+                for (int k = begin; k < end; k++)
+                {
+                    bitmap[pixels[k]] = packed_bitmap[k];
+                    period[pixels[k]] = packed_period[k];
+                }
+                if (last && job.tile_done)
+                {
+                    job.tile_done(pixels[begin], pixels[end - 1] + 1);
+                }
+            };
+
+            if (perturbation)
+            {
+                PerturbationStats stats = mandelbrot_perturbation(x0, y0, double(step), bitmap, period, width, height, params, SERIES_APPROXIMATION, &pool, job.generation, &pixels, &*reference);
+                total_power_count += stats.kernel.iterations;
+                fmt::print("perturbation, references {}, glitched {}, series_skip {}\n", stats.references, stats.glitched, stats.series_skip);
+            }
+            else if (precision == Precision::double_double)
+            {
+                mandelbrot_cpu_grid<DoubleDouble>(pool, x0, y0, double(step), width, pixels.data(), packed_bitmap, packed_period, n, params, pass_job);
+            }
+            else if (precision == Precision::fixed64)
+            {
+                mandelbrot_cpu_grid<Fixed64>(pool, x0, y0, double(step), width, pixels.data(), packed_bitmap, packed_period, n, params, pass_job);
+            }
+            else if (precision == Precision::fixed128)
+            {
+                mandelbrot_cpu_grid<Fixed128>(pool, x0, y0, double(step), width, pixels.data(), packed_bitmap, packed_period, n, params, pass_job);
+            }
+            else
+            {
+                mandelbrot_cpu(pool, mandelbrot_axes, pixels.data(), packed_bitmap, packed_period, n, params, precision, pass_job);
+            }
 
-    int cmap_size;
-    int bitmap_size;
+            if (job.generation.stale())
+            {
+                break;
+            }
+            if (!last)
+            {
+                fill_progressive_blocks(PROGRESSIVE_STRIDES[pass]);
+                copy_mirror_rows();
+            }
+            // perturbed pixels are only final after the last reference
+            if (job.tile_done && (!last || perturbation))
+            {
+                job.tile_done(0, NPIXEL);
+            }
+            if (PROGRESSIVE)
+            {
+                fmt::print("progressive pass 1/{}, {} pixels, elapsed {}\n", PROGRESSIVE_STRIDES[pass], n, rdsysns() - start);
+            }
+        }
+    }
 
-    double *cmap_i_host;
-    double *cmap_r_host;
-    double *cmap_i_device;
-    double *cmap_r_device;
+    // rows [begin, end) of the mandelbrot view mirror rows sum - y
+    struct MirrorRows
+    {
+        int begin = 0;
+        int end = 0;
+        int sum = 0;
+    };
+
+    // Where a frame is on the pixel lattice of its level: pixel (x, y) of the
+    // view is lattice pixel (origin.x + x, origin.y + y)
+    struct LatticeOrigin
+    {
+        int64_t x;
+        int64_t y;
+    };
 
-    int32_t width;
+    // None when the view is too deep for 64-bit pixel indices and is not on
+    // the lattice
+    std::optional<LatticeOrigin> lattice_origin(const MandelbrotFrame &frame, DoubleDouble step)
+    {
+        std::optional<int64_t> x = round_to_int64(frame.shift_x / step);
+        std::optional<int64_t> y = round_to_int64(frame.shift_y / step);
+        if (!x || !y)
+        {
+            return std::nullopt;
+        }
+        return LatticeOrigin{*x + frame.pan_x - width / 2, *y + frame.pan_y - height / 2};
+    }
+
+    // Calls visit(key, x0, y0, x1, y1) for every cache tile the view
+    // overlaps, with the view pixels [x0, x1) x [y0, y1) it covers
+    template <typename Visit>
+    void for_each_cache_tile(const LatticeOrigin &origin, const MandelbrotFrame &frame, Precision precision, Visit visit)
+    {
+        // rounded down, for negative indices too
+        auto tile_of = [](int64_t pixel) { return pixel >= 0 ? pixel / RENDER_TILE : -((-pixel + RENDER_TILE - 1) / RENDER_TILE); };
+        for (int64_t ty = tile_of(origin.y); ty <= tile_of(origin.y + height - 1); ty++)
+        {
+            for (int64_t tx = tile_of(origin.x); tx <= tile_of(origin.x + width - 1); tx++)
+            {
+                TileKey key{frame.level, tx, ty, frame.params.max_iteration, Formula::mandelbrot, precision};
+                int x0 = int(std::max<int64_t>(tx * RENDER_TILE - origin.x, 0));
+                int y0 = int(std::max<int64_t>(ty * RENDER_TILE - origin.y, 0));
+                int x1 = int(std::min<int64_t>((tx + 1) * RENDER_TILE - origin.x, width));
+                int y1 = int(std::min<int64_t>((ty + 1) * RENDER_TILE - origin.y, height));
+                visit(key, x0, y0, x1, y1);
+            }
+        }
+    }
+
+    // Copies the frame's tiles found in the cache into the mandelbrot
+    // bitmap and marks their pixels in skip_pixels. Returns the number
+    // of pixels found.
+    int load_cached_tiles(const std::optional<LatticeOrigin> &origin, const MandelbrotFrame &frame, Precision precision)
+    {
+        std::fill(skip_pixels.begin(), skip_pixels.end(), 0);
+        if (!origin || tile_cache.budget() == 0)
+        {
+            return 0;
+        }
+        // The hits are looked up first and copied a frame row at a time, so
+        // the bitmap is written in order rather than one tile at a time
+        struct Hit
+        {
+            const CachedTile *tile;
+            int from, x0, y0, x1, y1;
+        };
+        std::vector<Hit> hit_tiles;
+        int found = 0, tiles = 0;
+        for_each_cache_tile(*origin, frame, precision, [&](const TileKey &key, int x0, int y0, int x1, int y1) {
+            tiles++;
+            if (const CachedTile *tile = tile_cache.find(key))
+            {
+                int from = RENDER_TILE * int(origin->y - key.ty * RENDER_TILE) + int(origin->x + x0 - key.tx * RENDER_TILE);
+                hit_tiles.push_back({tile, from, x0, y0, x1, y1});
+            }
+        });
+        // the tiles are keyed by the iteration cap, so they hold counts of
+        // the frame's type
+        mandelbrot_counts.visit([&](auto *bitmap, auto *period) {
+            using Count = std::remove_pointer_t<decltype(bitmap)>;
+            for (size_t band = 0; band < hit_tiles.size();)
+            {
+                size_t band_end = band;
+                while (band_end < hit_tiles.size() && hit_tiles[band_end].y0 == hit_tiles[band].y0)
+                {
+                    band_end++;
+                }
+                for (int y = hit_tiles[band].y0; y < hit_tiles[band].y1; y++)
+                {
+                    for (size_t h = band; h < band_end; h++)
+                    {
+                        const Hit &hit = hit_tiles[h];
+                        const CachedTile *tile = hit.tile;
+                        const Count *tile_bitmap = tile->counts<Count>();
+                        const Count *tile_period = tile->periods<Count>();
+                        int from = hit.from + RENDER_TILE * y;
+                        int to = width * y + hit.x0;
+                        int n = hit.x1 - hit.x0;
+                        if (tile->valid_n == RENDER_TILE * RENDER_TILE)
+                        {
+                            std::copy(tile_bitmap + from, tile_bitmap + from + n, bitmap + to);
+                            std::copy(tile_period + from, tile_period + from + n, period + to);
+                            std::fill(skip_pixels.begin() + to, skip_pixels.begin() + to + n, 1);
+                            found += n;
+                            continue;
+                        }
+                        for (int k = 0; k < n; k++)
+                        {
+                            if (tile->valid[from + k])
+                            {
+                                bitmap[to + k] = tile_bitmap[from + k];
+                                period[to + k] = tile_period[from + k];
+                                skip_pixels[to + k] = 1;
+                                found++;
+                            }
+                        }
+                    }
+                }
+                band = band_end;
+            }
+        });
+        fmt::print("tile cache, {} of {} tiles, {} pixels, {} tiles in {} MB\n", hit_tiles.size(), tiles, found, tile_cache.size(), tile_cache.bytes() >> 20);
+        return found;
+    }
+
+    // Adds the pixels of a finished frame to the cache, filling in the
+    // tiles it already has in part
+    void store_tiles(const std::optional<LatticeOrigin> &origin, const MandelbrotFrame &frame, Precision precision)
+    {
+        if (!origin || tile_cache.budget() == 0)
+        {
+            return;
+        }
+        size_t count_bytes = count_size(mandelbrot_counts.type());
+        mandelbrot_counts.visit([&](auto *bitmap, auto *period) {
+            using Count = std::remove_pointer_t<decltype(bitmap)>;
+            for_each_cache_tile(*origin, frame, precision, [&](const TileKey &key, int x0, int y0, int x1, int y1) {
+                CachedTile *tile = tile_cache.find(key);
+                if (!tile)
+                {
+                    CachedTile empty;
+                    empty.bitmap.resize(RENDER_TILE * RENDER_TILE * count_bytes);
+                    empty.period.resize(RENDER_TILE * RENDER_TILE * count_bytes);
+                    empty.valid.resize(RENDER_TILE * RENDER_TILE);
+                    tile_cache.insert(key, std::move(empty));
+                    tile = tile_cache.find(key);
+                }
+                if (!tile || tile->valid_n == RENDER_TILE * RENDER_TILE)
+                {
+                    return;
+                }
+                for (int y = y0; y < y1; y++)
+                {
+                    int to = RENDER_TILE * int(origin->y + y - key.ty * RENDER_TILE) + int(origin->x + x0 - key.tx * RENDER_TILE);
+                    std::copy(bitmap + width * y + x0, bitmap + width * y + x1, tile->counts<Count>() + to);
+                    std::copy(period + width * y + x0, period + width * y + x1, tile->periods<Count>() + to);
+                    std::fill(tile->valid.begin() + to, tile->valid.begin() + to + x1 - x0, 1);
+                }
+                tile->valid_n = int(std::count(tile->valid.begin(), tile->valid.end(), 1));
+            });
+        });
+    }
+
+    // The Mandelbrot set is symmetric about the real axis, which is lattice
+    // row 0: row y of a view on the lattice is the mirror image of row
+    // -2 * origin.y - y. The rows below the axis whose mirror is in view are
+    // marked in skip_pixels and copied once their mirror is computed.
+    // Returns the number of pixels newly marked.
+    int mark_mirror_rows(const std::optional<LatticeOrigin> &origin)
+    {
+        mirror = {};
+        if (!origin || origin->y >= 0 || -origin->y >= height)
+        {
+            return 0;
+        }
+        mirror.sum = int(-2 * origin->y);
+        mirror.begin = std::max(mirror.sum - (height - 1), 0);
+        mirror.end = int(-origin->y);
+        if (mirror.begin >= mirror.end)
+        {
+            mirror = {};
+            return 0;
+        }
+        int marked = int(std::count(skip_pixels.begin() + width * mirror.begin, skip_pixels.begin() + width * mirror.end, 0));
+        std::fill(skip_pixels.begin() + width * mirror.begin, skip_pixels.begin() + width * mirror.end, 1);
+        return marked;
+    }
+
+    void copy_mirror_rows()
+    {
+        mandelbrot_counts.visit([&](auto *bitmap, auto *period) {
+            for (int y = mirror.begin; y < mirror.end; y++)
+            {
+                int from = width * (mirror.sum - y);
+                std::copy(bitmap + from, bitmap + from + width, bitmap + width * y);
+                std::copy(period + from, period + from + width, period + width * y);
+            }
+        });
+    }
+
+    // Whether the bitmap of the previous frame can be shifted into this one:
+    // the same view, moved by less than its size
+    bool pan_reusable(const MandelbrotFrame &previous, const MandelbrotFrame &frame)
+    {
+        const FractalParams &a = previous.params, &b = frame.params;
+        bool same_params = a.max_iteration == b.max_iteration && a.escape_radius == b.escape_radius && a.interior_test == b.interior_test && a.periodicity_tolerance == b.periodicity_tolerance;
+        return same_params && previous.mode == frame.mode && previous.zoom == frame.zoom && previous.shift_x == frame.shift_x && previous.shift_y == frame.shift_y &&
+               std::abs(frame.pan_x - previous.pan_x) < width && std::abs(frame.pan_y - previous.pan_y) < height;
+    }
+
+    // Pan: moves the previous frame's pixels by the whole pixels the view was
+    // dragged and computes only the rows and columns uncovered, so the work
+    // grows with the drag distance. A pan that turns stale stops early and
+    // is not reported done; its bitmap is incomplete, so the next frame
+    // starts over.
+    template <typename Count>
+    KernelStats render_pan(const MandelbrotFrame &frame, const MandelbrotFrame &previous, DoubleDouble step, Precision precision, bool perturbation, const RenderJob &job, Count *bitmap, Count *period)
+    {
+        // pixel (x, y) of the frame is pixel (x + dx, y + dy) of the previous one
+        int dx = int(frame.pan_x - previous.pan_x);
+        int dy = int(frame.pan_y - previous.pan_y);
+        int row_n = width - std::abs(dx);
+        for (int k = 0; k < height; k++)
+        {
+            // rows in the order that reads every source row before it is
+            // overwritten
+            int y = dy > 0 ? k : height - 1 - k;
+            if (y + dy >= 0 && y + dy < height)
+            {
+                int to = width * y + std::max(-dx, 0);
+                int from = width * (y + dy) + std::max(dx, 0);
+                std::memmove(bitmap + to, bitmap + from, row_n * sizeof(Count));
+                std::memmove(period + to, period + from, row_n * sizeof(Count));
+            }
+        }
+
+        std::vector<int> pixels;
+        for (int y = 0; y < height; y++)
+        {
+            bool row_uncovered = y + dy < 0 || y + dy >= height;
+            for (int x = 0; x < width; x++)
+            {
+                if (row_uncovered || x + dx < 0 || x + dx >= width)
+                {
+                    pixels.push_back(width * y + x);
+                }
+                else if (x == std::max(-dx, 0))
+                {
+                    // skip the shifted part of the row
+                    x += row_n - 1;
+                }
+            }
+        }
+
+        KernelStats stats;
+        if (perturbation)
+        {
+            PerturbationStats perturbation_stats = mandelbrot_perturbation(mandelbrot_x(frame, step, 0), mandelbrot_y(frame, step, 0), double(step), bitmap, period, width, height, frame.params, SERIES_APPROXIMATION, &pool, job.generation, &pixels);
+            stats = perturbation_stats.kernel;
+            fmt::print("perturbation, references {}, glitched {}, series_skip {}\n", perturbation_stats.references, perturbation_stats.glitched, perturbation_stats.series_skip);
+        }
+        else
+        {
+            std::mutex mutex;
+            pool.parallel_for(int(pixels.size()), CPU_TASK_PIXELS, [&](int begin, int end) {
+                KernelStats task_stats = compute_mandelbrot_pixels(frame, step, precision, pixels.data() + begin, end - begin);
+                std::lock_guard<std::mutex> lock(mutex);
+                stats += task_stats;
+            }, job.generation);
+        }
+        if (job.generation.stale())
+        {
+            return stats;
+        }
+        if (job.tile_done)
+        {
+            job.tile_done(0, NPIXEL);
+        }
+        fmt::print("pan {},{}, computed {} ({:.1f}%)\n", dx, dy, pixels.size(), 100.0 * pixels.size() / NPIXEL);
+        return stats;
+    }
+
+    // Computes the listed pixels of the frame on the calling thread, straight
+    // into the mandelbrot bitmap. Same coordinates and kernels as the brute
+    // force passes, so a pixel comes out the same either way.
+    KernelStats compute_mandelbrot_pixels(const MandelbrotFrame &frame, DoubleDouble step, Precision precision, const int *pixels, int n)
+    {
+        DoubleDouble x0 = mandelbrot_x(frame, step, 0);
+        DoubleDouble y0 = mandelbrot_y(frame, step, 0);
+        return mandelbrot_counts.visit([&](auto *view_bitmap, auto *view_period) {
+            using Count = std::remove_pointer_t<decltype(view_bitmap)>;
+            std::vector<Count> bitmap(n), period(n);
+            KernelStats stats;
+            if (precision == Precision::double_double)
+            {
+                stats = escape_time_pixels<DoubleDouble, Formula::mandelbrot>(x0, y0, double(step), 0.0, 0.0, pixels, width, bitmap.data(), period.data(), n, frame.params);
+            }
+            else if (precision == Precision::fixed64)
+            {
+                stats = escape_time_pixels<Fixed64, Formula::mandelbrot>(x0, y0, double(step), 0.0, 0.0, pixels, width, bitmap.data(), period.data(), n, frame.params);
+            }
+            else if (precision == Precision::fixed128)
+            {
+                stats = escape_time_pixels<Fixed128, Formula::mandelbrot>(x0, y0, double(step), 0.0, 0.0, pixels, width, bitmap.data(), period.data(), n, frame.params);
+            }
+            else
+            {
+                CpuKernels<Count> kernels = cpu_kernels<Count>();
+                auto kernel = precision == Precision::float32 ? kernels.mandelbrot_float : kernels.mandelbrot;
+                stats = grid_kernel(mandelbrot_axes, pixels, bitmap.data(), period.data(), n, [&](const double *cr, const double *ci, Count *b, Count *p, int count) {
+                    return kernel(cr, ci, b, p, count, frame.params);
+                });
+            }
+            for (int k = 0; k < n; k++)
+            {
+                view_bitmap[pixels[k]] = bitmap[k];
+                view_period[pixels[k]] = period[k];
+            }
+            return stats;
+        });
+    }
+
+    // Julia version of compute_mandelbrot_pixels()
+    KernelStats compute_julia_pixels(const JuliaFrame &frame, Precision precision, const int *pixels, int n)
+    {
+        return julia_counts.visit([&](auto *view_bitmap, auto *view_period) {
+            using Count = std::remove_pointer_t<decltype(view_bitmap)>;
+            CpuKernels<Count> kernels = cpu_kernels<Count>();
+            auto kernel = precision == Precision::float32 ? kernels.julia_float : kernels.julia;
+            std::vector<Count> bitmap(n), period(n);
+            KernelStats stats = grid_kernel(julia_axes, pixels, bitmap.data(), period.data(), n, [&](const double *xr, const double *xi, Count *b, Count *p, int count) {
+                return kernel(xr, xi, frame.c.real(), frame.c.imag(), b, p, count, frame.params);
+            });
+            for (int k = 0; k < n; k++)
+            {
+                view_bitmap[pixels[k]] = bitmap[k];
+                view_period[pixels[k]] = period[k];
+            }
+            return stats;
+        });
+    }
+
+    // Runs a tile renderer (subdivide_tile or trace_tile) over RENDER_TILE
+    // square tiles of a view, one pool task each. compute(pixels, n)
+    // computes pixels into the view's buffers and returns their stats.
+    // Finished tiles are drawn row by row.
+    //
+    // The tile grid is moved left and up by (tile_x, tile_y) pixels, the
+    // edge tiles being cut to the view. Tiles whose pixels are all marked
+    // in skip are left as they are.
+    template <typename TileRenderer, typename Count, typename Compute>
+    KernelStats render_tiles(TileRenderer renderer, Count *bitmap, Count *period, const RenderJob &job, const char *name, Compute compute, int tile_x = 0, int tile_y = 0, const std::vector<uint8_t> *skip = nullptr)
+    {
+        int tiles_x = (width + tile_x + RENDER_TILE - 1) / RENDER_TILE;
+        int tiles_y = (height + tile_y + RENDER_TILE - 1) / RENDER_TILE;
+        std::mutex mutex;
+        KernelStats kernel_stats;
+        TileStats stats;
+        pool.parallel_for(tiles_x * tiles_y, 1, [&](int begin, int end) {
+            for (int tile = begin; tile < end; tile++)
+            {
+                int x0 = std::max(tile % tiles_x * RENDER_TILE - tile_x, 0);
+                int y0 = std::max(tile / tiles_x * RENDER_TILE - tile_y, 0);
+                int x1 = std::min((tile % tiles_x + 1) * RENDER_TILE - tile_x, width) - 1;
+                int y1 = std::min((tile / tiles_x + 1) * RENDER_TILE - tile_y, height) - 1;
+                bool skipped = skip != nullptr;
+                for (int y = y0; y <= y1 && skipped; y++)
+                {
+                    skipped = std::all_of(skip->begin() + width * y + x0, skip->begin() + width * y + x1 + 1, [](uint8_t s) { return s != 0; });
+                }
+                KernelStats tile_kernel_stats;
+                TileStats tile_stats;
+                if (!skipped)
+                {
+                    tile_stats = renderer(x0, y0, x1, y1, width, bitmap, period, [&](const int *pixels, int n) {
+                        tile_kernel_stats += compute(pixels, n);
+                    });
+                }
+                if (job.tile_done)
+                {
+                    for (int y = y0; y <= y1; y++)
+                    {
+                        job.tile_done(width * y + x0, width * y + x1 + 1);
+                    }
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                kernel_stats += tile_kernel_stats;
+                stats += tile_stats;
+            }
+        }, job.generation);
+
+        fmt::print("{}, computed {} ({:.1f}%), filled {}\n", name, stats.computed, 100.0 * stats.computed / NPIXEL, stats.filled);
+        return kernel_stats;
+    }
+
+    // How evenly the last render was spread: busy share over all threads,
+    // then busy / idle milliseconds and tasks (stolen ones) per thread
+    void print_thread_load()
+    {
+        std::vector<ThreadLoad> load = pool.load();
+        int64_t busy = 0, total = 0;
+        uint64_t steals = 0;
+        std::string threads;
+        for (const ThreadLoad &l : load)
+        {
+            busy += l.busy_ns;
+            total += l.busy_ns + l.idle_ns;
+            steals += l.steals;
+            threads += fmt::format(" {:.1f}/{:.1f}:{}({})", l.busy_ns / 1e6, l.idle_ns / 1e6, l.tasks, l.steals);
+        }
+        fmt::print("thread load, threads {}, busy {:.1f}%, steals {}, busy/idle ms:tasks(stolen){}\n", load.size(), 100.0 * busy / std::max<int64_t>(total, 1), steals, threads);
+    }
+
+    // largest coordinate magnitude in the mandelbrot view for a pixel step
+    double mandelbrot_extent(const MandelbrotFrame &frame, double step)
+    {
+        double center_x = double(mandelbrot_x(frame, step, width / 2));
+        double center_y = double(mandelbrot_y(frame, step, height / 2));
+        return std::max(std::abs(center_x) + step * width / 2, std::abs(center_y) + step * height / 2);
+    }
+
+    // Precision for the next frame of one of the views. current keeps the
+    // last choice, for the hysteresis in choose_precision().
+    Precision update_precision(Precision &current, const FractalParams &params, double step, double extent)
+    {
+        Precision precision = FORCED_PRECISION ? *FORCED_PRECISION : choose_precision(step, extent, params, current);
+        bool fixed = precision == Precision::fixed64 || precision == Precision::fixed128;
+        if (fixed && !fixed_point_supported(params))
+        {
+            precision = Precision::double_double;
+        }
+        else if (FIXED_POINT && precision == Precision::double_double && fixed_point_supported(params))
+        {
+            precision = choose_fixed_precision(step);
+        }
+        if (precision != current)
+        {
+            fmt::print("precision {} -> {}, step {}\n", precision_name(current), precision_name(precision), step);
+            current = precision;
+        }
+        return precision;
+    }
+
+    bool should_draw = true;
+    bool color_period = false;
+    // CPU path: the view the mandelbrot half of the screen shows, as
+    // previewed, and a copy of that half to resample from
+    MandelbrotFrame screen_frame;
+    std::vector<olc::Pixel> screen_copy;
+    RenderMode render_mode = RENDER_MODE;
+
+    // CPU path only: render_thread runs the requested frames and the UI
+    // thread draws their tiles. The generations are bumped by every request,
+    // which makes the frame in progress stale.
+    std::thread render_thread;
+    std::mutex render_mutex;
+    std::condition_variable render_wake;
+    std::optional<MandelbrotFrame> mandelbrot_request;
+    std::optional<JuliaFrame> julia_request;
+    bool render_stopping = false;
+    std::atomic<uint64_t> mandelbrot_generation{0};
+    std::atomic<uint64_t> julia_generation{0};
+    std::mutex tile_mutex;
+    std::vector<FinishedTile> finished_tiles;
+    Precision mandelbrot_precision = Precision::float32;
+    Precision julia_precision = Precision::float32;
+    // render thread only: the frame mandelbrot_counts holds in full, and the
+    // precision it was rendered in
+    std::optional<MandelbrotFrame> rendered_mandelbrot;
+    Precision rendered_precision = Precision::float32;
+    // in the order of the constructor's initializer list
     int32_t height;
+    int32_t width;
+    FractalParams params;
+    // render threads, started once and shared by both views
+    ThreadPool pool;
+    // render thread only: mandelbrot tiles of past frames, the pixels of the
+    // frame in progress that are not computed (found in the cache, or
+    // mirror images of computed ones) and its mirrored rows
+    TileCache tile_cache;
+    std::vector<uint8_t> skip_pixels;
+    MirrorRows mirror;
+    // counts and periods of the two views, in the type of the iteration cap
+    // of the frame they hold. On the CPU path they belong to the render
+    // thread.
+    CountBuffers mandelbrot_counts;
+    CountBuffers julia_counts;
+    // UI thread, CPU path: what the two views show, stored from the copies
+    // their finished tiles carry
+    CountBuffers mandelbrot_shown;
+    CountBuffers julia_shown;
+    // GPU path: kernel results of either view, room for uint32_t counts
+    void *mandelbrot_result_gpu;
+    void *period_result_gpu;
+
+    std::vector<int> all_pixels;
+    std::vector<std::vector<int>> all_pixel_passes;
+    std::vector<std::vector<int>> progressive_passes;
+    // kernel results of the current pass, before they go to the bitmap, in
+    // the type of the view they are for
+    CountBuffers packed_counts;
+    // pixels of the julia view that are computed, and the ones that are
+    // rotations of them, see rotate_julia()
+    std::vector<int> julia_pixels;
+    std::vector<uint8_t> julia_rotated;
+    // pixel coordinates of the CPU views, the mandelbrot ones are refilled
+    // by every frame
+    PixelAxes mandelbrot_axes;
+    PixelAxes julia_axes;
+
+    // julia_pixels on the device
+    int *julia_pixels_device;
+
     int NPIXEL;
-    double zoom = 1.0;
+    // view state in double-double, so it stays exact past the point where
+    // double pixel coordinates collapse (zoom around 1e13)
+    DoubleDouble zoom = 1.0;
+    // mouse wheel notches zoomed in, see zoom_at_level()
+    int zoom_level = 0;
     double range = 3.0;
-    double shift_x = -0.8;
-    double shift_y = 0.0;
+    DoubleDouble shift_x = -0.8;
+    DoubleDouble shift_y = 0.0;
+    int64_t pan_x = 0;
+    int64_t pan_y = 0;
     int mouse_x_old = 0;
     int mouse_y_old = 0;
 };
 
-int main()
+// Compare every CPU kernel against the runtime-parameter escape_time() over
+// the default view and a band around the set boundary, for the default
+// settings, other specialized caps and the runtime-parameter path.
+int check_kernels()
+{
+    int width = 800, height = 800;
+    int n = width * height;
+    std::vector<double> cr(n), ci(n);
+    std::vector<uint32_t> expected(n), actual(n);
+    std::vector<uint32_t> expected_period(n), actual_period(n);
+    int failed = 0;
+
+    double step = 3.0 / width;
+    auto mandelbrot_view = [&]() {
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                cr[width * y + x] = (x - width / 2) * step - 0.8;
+                ci[width * y + x] = (y - height / 2) * step;
+            }
+        }
+        // shift the second half to a zoomed-in boundary region
+        for (int i = n / 2; i < n; i++)
+        {
+            cr[i] = cr[i] * 1e-3 - 0.7435;
+            ci[i] = ci[i] * 1e-3 + 0.1314;
+        }
+    };
+    auto julia_view = [&]() {
+        for (int i = 0; i < n; i++)
+        {
+            cr[i] = (i % width - width / 2) * step;
+            ci[i] = (i / width - height / 2) * step;
+        }
+    };
+    auto report = [&](std::string name) {
+        // odd length to exercise the tail handling
+        int mismatch = 0;
+        for (int i = 0; i < n - 3; i++)
+        {
+            mismatch += actual[i] != expected[i] || actual_period[i] != expected_period[i];
+        }
+        fmt::print("{}: {} mismatches out of {}\n", name, mismatch, n - 3);
+        failed += mismatch != 0;
+    };
+
+    std::vector<Isa> isas;
+    for (Isa isa : {Isa::scalar, Isa::sse42, Isa::avx2, Isa::avx512})
+    {
+        if (isa_supported(isa))
+        {
+            isas.push_back(isa);
+        }
+    }
+
+    // Runs kernel(kernels, bitmap, period) for every supported isa, storing
+    // the count type the views use for the cap, and reports the counts.
+    auto check_isas = [&](const FractalParams &params, std::string name, std::string suffix, auto kernel) {
+        with_count_type(count_type(params.max_iteration), [&](auto *tag) {
+            using Count = std::remove_pointer_t<decltype(tag)>;
+            std::vector<Count> bitmap(n), period(n);
+            for (Isa isa : isas)
+            {
+                kernel(cpu_kernels<Count>(isa), bitmap.data(), period.data());
+                std::copy(bitmap.begin(), bitmap.end(), actual.begin());
+                std::copy(period.begin(), period.end(), actual_period.begin());
+                report(fmt::format("  {}_{}{}", name, isa_name(isa), suffix));
+            }
+        });
+    };
+
+    // The julia view is centered on the origin: a pixel whose rotation is in
+    // view has to come out the same as it, see rotate_julia(). The kernels
+    // are checked against the reference, so checking it is enough.
+    auto check_rotation = [&](std::string name) {
+        int mismatch = 0;
+        for (int i = 0; i < n; i++)
+        {
+            int x = 2 * (width / 2) - i % width;
+            int y = 2 * (height / 2) - i / width;
+            if (x < width && y < height)
+            {
+                int rotated = width * y + x;
+                mismatch += expected[i] != expected[rotated] || expected_period[i] != expected_period[rotated];
+            }
+        }
+        fmt::print("{}: {} mismatches\n", name, mismatch);
+        failed += mismatch != 0;
+    };
+
+    // scalar reference for one pixel, with its period
+    auto reference = [&](int i, uint32_t count, uint32_t period) {
+        expected[i] = count;
+        expected_period[i] = period;
+    };
+
+    std::vector<FractalParams> param_sets = {
+        {}, {1023, ESCAPE_RADIUS}, {1000, ESCAPE_RADIUS}, {255, 3.0}, {255, ESCAPE_RADIUS, false}, {4095, ESCAPE_RADIUS, false, 1e-9}, {1023, ESCAPE_RADIUS, true, 0.0},
+    };
+    for (const FractalParams &params : param_sets)
+    {
+        fmt::print("max_iteration {}, escape_radius {}, interior_test {}, periodicity_tolerance {}\n", params.max_iteration, params.escape_radius, params.interior_test, params.periodicity_tolerance);
+
+        // the shortcuts only change how fast interior points are found, the
+        // counts have to match plain iteration
+        mandelbrot_view();
+        FractalParams brute_force = params;
+        brute_force.interior_test = false;
+        brute_force.periodicity_tolerance = 0.0;
+        for (int i = 0; i < n; i++)
+        {
+            expected[i] = mandelbrot(complex_d{cr[i], ci[i]}, brute_force);
+            actual[i] = mandelbrot(complex_d{cr[i], ci[i]}, params);
+            expected_period[i] = actual_period[i] = 0;
+        }
+        report("  interior test and cycle detection against brute force");
+
+        for (int i = 0; i < n; i++)
+        {
+            uint32_t p;
+            uint32_t count = escape_time<double, Formula::mandelbrot>(cr[i], ci[i], 0.0, 0.0, params, &p);
+            reference(i, count, p);
+        }
+        check_isas(params, "mandelbrot", "", [&](auto kernels, auto *bitmap, auto *period) {
+            kernels.mandelbrot(cr.data(), ci.data(), bitmap, period, n - 3, params);
+        });
+
+        for (int i = 0; i < n; i++)
+        {
+            uint32_t p;
+            uint32_t count = escape_time<float, Formula::mandelbrot>(float(cr[i]), float(ci[i]), 0.0f, 0.0f, params, &p);
+            reference(i, count, p);
+        }
+        check_isas(params, "mandelbrot", "_float", [&](auto kernels, auto *bitmap, auto *period) {
+            kernels.mandelbrot_float(cr.data(), ci.data(), bitmap, period, n - 3, params);
+        });
+
+        // julia over the centered view, for a few c inside and outside the
+        // set. The last one puts a repelling fixed point within 1e-12 of
+        // pixel (600, 500), whose z1 then lands next to its z0 but not next
+        // to the rotation's.
+        julia_view();
+        for (complex_d c : {complex_d{-0.8, 0.156}, complex_d{0.285, 0.01}, complex_d{-0.4, 0.6}, complex_d{0.4, 0.4}, complex_d{0.32812500000080003, -0.1874999999992}})
+        {
+            for (int i = 0; i < n; i++)
+            {
+                uint32_t p;
+                uint32_t count = escape_time<double, Formula::julia>(cr[i], ci[i], c.real(), c.imag(), params, &p);
+                reference(i, count, p);
+            }
+            check_rotation(fmt::format("  julia rotation c={}{:+}i", c.real(), c.imag()));
+            check_isas(params, "julia", fmt::format(" c={}{:+}i", c.real(), c.imag()), [&](auto kernels, auto *bitmap, auto *period) {
+                kernels.julia(cr.data(), ci.data(), c.real(), c.imag(), bitmap, period, n - 3, params);
+            });
+
+            for (int i = 0; i < n; i++)
+            {
+                uint32_t p;
+                uint32_t count = escape_time<float, Formula::julia>(float(cr[i]), float(ci[i]), float(c.real()), float(c.imag()), params, &p);
+                reference(i, count, p);
+            }
+            check_rotation(fmt::format("  julia rotation c={}{:+}i float", c.real(), c.imag()));
+            check_isas(params, "julia", fmt::format("_float c={}{:+}i", c.real(), c.imag()), [&](auto kernels, auto *bitmap, auto *period) {
+                kernels.julia_float(cr.data(), ci.data(), c.real(), c.imag(), bitmap, period, n - 3, params);
+            });
+        }
+    }
+
+    // the threaded CPU paths against one call over the whole view
+    ThreadPool pool(4);
+    FractalParams params;
+    std::vector<int> all(n);
+    std::iota(all.begin(), all.end(), 0);
+    PixelGrid mandelbrot_grid{-0.8, 0.0, step, -(width / 2), -(height / 2), width};
+    for (int i = 0; i < n; i++)
+    {
+        cr[i] = mandelbrot_grid.x(i);
+        ci[i] = mandelbrot_grid.y(i);
+    }
+    cpu_kernels<uint32_t>().mandelbrot(cr.data(), ci.data(), expected.data(), expected_period.data(), n, params);
+    mandelbrot_cpu(pool, PixelAxes(mandelbrot_grid, height), all.data(), actual.data(), actual_period.data(), n, params, Precision::float64);
+    report("threaded mandelbrot_cpu");
+    // the julia grid has to give the julia coordinates exactly
+    julia_view();
+    PixelGrid julia_grid{0.0, 0.0, step, -(width / 2), -(height / 2), width};
+    int grid_mismatch = 0;
+    for (int i = 0; i < n; i++)
+    {
+        grid_mismatch += cr[i] != julia_grid.x(i) || ci[i] != julia_grid.y(i);
+    }
+    fmt::print("julia pixel grid: {} mismatches out of {}\n", grid_mismatch, n);
+    failed += grid_mismatch != 0;
+    cpu_kernels<uint32_t>().julia_float(cr.data(), ci.data(), -0.8, 0.156, expected.data(), expected_period.data(), n, params);
+    julia_cpu(pool, PixelAxes(julia_grid, height), all.data(), {-0.8, 0.156}, actual.data(), actual_period.data(), n, params, Precision::float32);
+    report("threaded julia_cpu");
+    escape_time_grid<DoubleDouble, Formula::mandelbrot>(-2.0, -1.5, step, 0.0, 0.0, expected.data(), expected_period.data(), width, height, params);
+    mandelbrot_cpu_grid<DoubleDouble>(pool, -2.0, -1.5, step, width, all.data(), actual.data(), actual_period.data(), n, params);
+    report("threaded mandelbrot_cpu_grid");
+
+    // boundary tracing has to reproduce the brute-force counts on the
+    // regression views. The period is left out: it is noisy inside the set,
+    // and the fill copies it from a neighbour. The counts are traced in the
+    // type the views use for the default cap.
+    std::vector<uint8_t> traced(n), traced_period(n);
+    auto trace_view = [&](std::string name, const std::function<void(const int *, int)> &compute) {
+        int tile = 80; // divides the two halves of the mandelbrot view
+        for (int y = 0; y < height; y += tile)
+        {
+            for (int x = 0; x < width; x += tile)
+            {
+                trace_tile(x, y, x + tile - 1, y + tile - 1, width, traced.data(), traced_period.data(), compute);
+            }
+        }
+        int mismatch = 0;
+        for (int i = 0; i < n; i++)
+        {
+            mismatch += traced[i] != expected[i];
+        }
+        fmt::print("{}: {} mismatches out of {}\n", name, mismatch, n);
+        failed += mismatch != 0;
+    };
+    mandelbrot_view();
+    for (int i = 0; i < n; i++)
+    {
+        expected[i] = escape_time<double, Formula::mandelbrot>(cr[i], ci[i], 0.0, 0.0, params);
+    }
+    trace_view("boundary trace mandelbrot", [&](const int *pixels, int count) {
+        for (int k = 0; k < count; k++)
+        {
+            int i = pixels[k];
+            uint32_t p;
+            traced[i] = escape_time<double, Formula::mandelbrot>(cr[i], ci[i], 0.0, 0.0, params, &p);
+            traced_period[i] = p;
+        }
+    });
+    julia_view();
+    for (complex_d c : {complex_d{-0.8, 0.156}, complex_d{0.285, 0.01}, complex_d{-0.4, 0.6}, complex_d{0.4, 0.4}})
+    {
+        for (int i = 0; i < n; i++)
+        {
+            expected[i] = escape_time<double, Formula::julia>(cr[i], ci[i], c.real(), c.imag(), params);
+        }
+        trace_view(fmt::format("boundary trace julia c={}{:+}i", c.real(), c.imag()), [&](const int *pixels, int count) {
+            for (int k = 0; k < count; k++)
+            {
+                int i = pixels[k];
+                uint32_t p;
+                traced[i] = escape_time<double, Formula::julia>(cr[i], ci[i], c.real(), c.imag(), params, &p);
+                traced_period[i] = p;
+            }
+        });
+    }
+
+    // double-double arithmetic on cases with a known exact result
+    DoubleDouble big = 4503599627370497.0; // 2^52 + 1, needs the low word once squared
+    DoubleDouble third = DoubleDouble(1.0) / 3.0;
+    bool dd_ok = big * big == DoubleDouble(std::ldexp(1.0, 104) + std::ldexp(1.0, 53), 1.0) &&
+                 (DoubleDouble(1.0) + 1e-20) - 1.0 == DoubleDouble(1e-20) &&
+                 std::abs(double(third * 3.0 - 1.0)) < 1e-31;
+    fmt::print("double-double arithmetic: {}\n", dd_ok ? "ok" : "wrong");
+    failed += !dd_ok;
+
+    // perturbation and fixed point against plain double-double iteration on
+    // a deep view. They all round differently, so a few chaotic boundary
+    // pixels may differ.
+    for (double deep_step : {1e-17, 1e-22})
+    {
+        int side = 128;
+        FractalParams params{4095, ESCAPE_RADIUS, false, 0.0};
+        DoubleDouble x0 = DoubleDouble(-0.743643887037151) - side / 2 * deep_step;
+        DoubleDouble y0 = DoubleDouble(0.131825904205330) - side / 2 * deep_step;
+        std::vector<uint16_t> dd(side * side), perturbed(side * side);
+        escape_time_grid<DoubleDouble, Formula::mandelbrot, uint16_t>(x0, y0, deep_step, 0.0, 0.0, dd.data(), nullptr, side, side, params);
+        PerturbationStats stats = mandelbrot_perturbation<uint16_t>(x0, y0, deep_step, perturbed.data(), nullptr, side, side, params);
+        int differ = 0;
+        for (int i = 0; i < side * side; i++)
+        {
+            differ += dd[i] != perturbed[i];
+        }
+        fmt::print("perturbation step {}: {} of {} differ from double-double, {} references, {} glitched, series_skip {}\n", deep_step, differ, side * side, stats.references, stats.glitched, stats.series_skip);
+        failed += differ > side * side / 100 || stats.glitched != 0;
+
+        // split between threads it has to come out exactly the same
+        std::vector<uint16_t> threaded(side * side);
+        PerturbationStats threaded_stats = mandelbrot_perturbation<uint16_t>(x0, y0, deep_step, threaded.data(), nullptr, side, side, params, true, &pool);
+        bool same = threaded == perturbed && threaded_stats.references == stats.references && threaded_stats.kernel.iterations == stats.kernel.iterations;
+        fmt::print("threaded perturbation step {}: {}\n", deep_step, same ? "same" : "different");
+        failed += !same;
+
+        // fixed point has a few more bits than double-double at this scale
+        std::vector<uint16_t> fixed(side * side);
+        escape_time_grid<Fixed128, Formula::mandelbrot, uint16_t>(x0, y0, deep_step, 0.0, 0.0, fixed.data(), nullptr, side, side, params);
+        differ = 0;
+        for (int i = 0; i < side * side; i++)
+        {
+            differ += dd[i] != fixed[i];
+        }
+        fmt::print("fixed128 step {}: {} of {} differ from double-double\n", deep_step, differ, side * side);
+        failed += differ > side * side / 100;
+    }
+    return failed ? 1 : 0;
+}
+
+// The number after the '=' of a numeric flag, or none when that is not a
+// number from min to max, which expected describes for the usage error
+template <typename T>
+std::optional<T> flag_value(const std::string &arg, T min, T max, const char *expected)
 {
+    std::string text = arg.substr(arg.find('=') + 1);
+    size_t used = 0;
+    std::optional<T> value;
+    try
+    {
+        if constexpr (std::is_integral_v<T>)
+        {
+            long long parsed = std::stoll(text, &used);
+            if (parsed >= 0 || std::is_signed_v<T>)
+            {
+                value = T(parsed);
+            }
+        }
+        else
+        {
+            value = T(std::stod(text, &used));
+        }
+    }
+    catch (const std::exception &)
+    {
+    }
+    if (!value || used != text.size() || !(*value >= min && *value <= max))
+    {
+        fmt::print("invalid value in {}, expected {}\n", arg, expected);
+        return std::nullopt;
+    }
+    return value;
+}
+
+int main(int argc, char **argv)
+{
+    int device_count = 0;
+    if (hipGetDeviceCount(&device_count) != hipSuccess || device_count == 0)
+    {
+        GPU_CALC = false;
+    }
+
+    bool check = false;
+    FractalParams params;
+    std::string isa = getenv("FRACTAL_ISA") ? getenv("FRACTAL_ISA") : "";
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--check")
+        {
+            check = true;
+        }
+        else if (arg == "--bench")
+        {
+            BENCHMARK = true;
+        }
+        else if (arg == "--cpu")
+        {
+            GPU_CALC = false;
+        }
+        else if (arg.rfind("--isa=", 0) == 0)
+        {
+            // scalar, sse4.2, avx2 or avx512
+            isa = arg.substr(6);
+        }
+        else if (arg.rfind("--max-iter=", 0) == 0)
+        {
+            // the SIMD kernels count in int
+            std::optional<uint32_t> value = flag_value<uint32_t>(arg, 1, INT32_MAX, "a whole number from 1 to 2147483647");
+            if (!value)
+            {
+                return 2;
+            }
+            params.max_iteration = *value;
+        }
+        else if (arg.rfind("--escape-radius=", 0) == 0)
+        {
+            std::optional<double> value = flag_value(arg, std::numeric_limits<double>::min(), std::numeric_limits<double>::max(), "a number above 0");
+            if (!value)
+            {
+                return 2;
+            }
+            params.escape_radius = *value;
+        }
+        else if (arg == "--no-interior-test")
+        {
+            params.interior_test = false;
+        }
+        else if (arg == "--precision=float")
+        {
+            FORCED_PRECISION = Precision::float32;
+        }
+        else if (arg == "--precision=double")
+        {
+            FORCED_PRECISION = Precision::float64;
+        }
+        else if (arg == "--precision=double-double")
+        {
+            FORCED_PRECISION = Precision::double_double;
+        }
+        else if (arg == "--no-perturbation")
+        {
+            PERTURBATION = false;
+        }
+        else if (arg == "--fixed-point")
+        {
+            FIXED_POINT = true;
+        }
+        else if (arg == "--precision=fixed64")
+        {
+            FORCED_PRECISION = Precision::fixed64;
+        }
+        else if (arg == "--precision=fixed128")
+        {
+            FORCED_PRECISION = Precision::fixed128;
+        }
+        else if (arg == "--renderer=brute-force")
+        {
+            RENDER_MODE = RenderMode::brute_force;
+        }
+        else if (arg == "--renderer=subdivision")
+        {
+            RENDER_MODE = RenderMode::subdivision;
+        }
+        else if (arg == "--renderer=boundary-trace")
+        {
+            RENDER_MODE = RenderMode::boundary_trace;
+        }
+        else if (arg == "--no-progressive")
+        {
+            PROGRESSIVE = false;
+        }
+        else if (arg == "--no-series")
+        {
+            SERIES_APPROXIMATION = false;
+        }
+        else if (arg.rfind("--tile-cache=", 0) == 0)
+        {
+            // MB, 0 turns the cache off
+            std::optional<size_t> value = flag_value<size_t>(arg, 0, SIZE_MAX >> 20, "a whole number of MB");
+            if (!value)
+            {
+                return 2;
+            }
+            TILE_CACHE_MB = *value;
+        }
+        else if (arg.rfind("--threads=", 0) == 0)
+        {
+            std::optional<uint32_t> value = flag_value<uint32_t>(arg, 1, 1024, "a whole number from 1 to 1024");
+            if (!value)
+            {
+                return 2;
+            }
+            THREAD_N = *value;
+        }
+        else if (arg.rfind("--period-tolerance=", 0) == 0)
+        {
+            // 0 turns cycle detection off
+            std::optional<double> value = flag_value(arg, 0.0, std::numeric_limits<double>::max(), "a number of 0 or more");
+            if (!value)
+            {
+                return 2;
+            }
+            params.periodicity_tolerance = *value;
+        }
+    }
+
+    select_cpu_kernels(isa);
+    if (check)
+    {
+        return check_kernels();
+    }
 
     // The following line is used to compile the sample for the game engine.
     // g++ olcExampleProgram.cpp -lpng -lGL -lX11
-    MandelbrotDisplay m(1600, 1600);
+    MandelbrotDisplay m(1600, 1600, params, THREAD_N ? THREAD_N : default_thread_count(N_THREAD));
+    if (BENCHMARK)
+    {
+        return m.benchmark();
+    }
 
     m.Start();
 
@@ -0,0 +1,354 @@
+#include "perturbation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <optional>
+
+ReferenceOrbit reference_orbit(const BigFixed &cr, const BigFixed &ci, const FractalParams &params)
+{
+    double bailout = params.escape_radius * params.escape_radius;
+    ReferenceOrbit orbit;
+    orbit.zr.push_back(to_double(cr));
+    orbit.zi.push_back(to_double(ci));
+
+    BigFixed x = cr, y = ci;
+    for (uint32_t i = 0; i < params.max_iteration; i++)
+    {
+        BigFixed xy = x * y;
+        x = x * x - y * y + cr;
+        y = xy + xy + ci;
+
+        double zr = to_double(x);
+        double zi = to_double(y);
+        orbit.zr.push_back(zr);
+        orbit.zi.push_back(zi);
+        if (zr * zr + zi * zi > bailout)
+        {
+            break;
+        }
+    }
+    return orbit;
+}
+
+// Coefficients s_k = a_k * scale^k after `iteration` steps, starting from
+// dz_0 = dc (a_1 = 1). Squaring the series gives
+//     a_1' = 2 Z a_1 + 1,   a_k' = 2 Z a_k + sum_{j<k} a_j a_{k-j}
+static void advance_series(std::complex<double> *s, std::complex<double> z, double scale)
+{
+    std::complex<double> next[SERIES_TERMS];
+    for (int k = 0; k < SERIES_TERMS; k++)
+    {
+        next[k] = 2.0 * z * s[k];
+        for (int j = 0; j < k; j++)
+        {
+            next[k] += s[j] * s[k - 1 - j];
+        }
+    }
+    next[0] += scale;
+    std::copy(next, next + SERIES_TERMS, s);
+}
+
+static SeriesApproximation series_at(const ReferenceOrbit &ref, double scale, uint32_t iteration)
+{
+    SeriesApproximation series;
+    series.scale = scale;
+    series.coefficients[0] = scale;
+    for (uint32_t n = 0; n < iteration; n++)
+    {
+        advance_series(series.coefficients, {ref.zr[n], ref.zi[n]}, scale);
+    }
+    series.skip = iteration;
+    return series;
+}
+
+std::complex<double> evaluate(const SeriesApproximation &series, std::complex<double> dc)
+{
+    std::complex<double> u = dc / series.scale;
+    std::complex<double> sum = series.coefficients[SERIES_TERMS - 1];
+    for (int k = SERIES_TERMS - 2; k >= 0; k--)
+    {
+        sum = sum * u + series.coefficients[k];
+    }
+    return sum * u;
+}
+
+// dz_n of one point by plain perturbation, false if it escaped on the way
+static bool perturbed_delta(const ReferenceOrbit &ref, std::complex<double> dc, uint32_t n, double bailout, std::complex<double> &dz)
+{
+    dz = dc;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        std::complex<double> z_ref{ref.zr[i], ref.zi[i]};
+        dz = 2.0 * z_ref * dz + dz * dz + dc;
+        if (std::norm(std::complex<double>{ref.zr[i + 1], ref.zi[i + 1]} + dz) > bailout)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+SeriesApproximation series_approximation(const ReferenceOrbit &ref, double radius, double step, const FractalParams &params)
+{
+    double bailout = params.escape_radius * params.escape_radius;
+    // largest error allowed on dz, a fraction of how far apart the deltas
+    // of neighbouring pixels are
+    auto allowed_error = [&](const SeriesApproximation &series) { return SERIES_TOLERANCE * std::abs(series.coefficients[0]) * step / radius; };
+
+    // run the series while its last term stays inside the error bound; the
+    // omitted terms are smaller still while the series converges
+    SeriesApproximation series;
+    series.scale = radius;
+    series.coefficients[0] = radius;
+    uint32_t limit = std::min<uint32_t>(params.max_iteration, uint32_t(ref.zr.size() - 1));
+    uint32_t skip = 0;
+    while (skip < limit)
+    {
+        SeriesApproximation next = series;
+        advance_series(next.coefficients, {ref.zr[skip], ref.zi[skip]}, radius);
+        if (std::abs(next.coefficients[SERIES_TERMS - 1]) > allowed_error(next))
+        {
+            break;
+        }
+        series = next;
+        skip++;
+    }
+    series.skip = skip;
+
+    // the bound is a heuristic, so check it against plain perturbation at
+    // the edge of the frame and back off until it holds there
+    const std::complex<double> probes[] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {0.7071, 0.7071}, {-0.7071, 0.7071}, {0.7071, -0.7071}, {-0.7071, -0.7071}};
+    while (series.skip > 0)
+    {
+        bool valid = true;
+        for (std::complex<double> probe : probes)
+        {
+            std::complex<double> dc = probe * radius;
+            std::complex<double> dz;
+            if (!perturbed_delta(ref, dc, series.skip, bailout, dz) || std::abs(evaluate(series, dc) - dz) > allowed_error(series))
+            {
+                valid = false;
+                break;
+            }
+        }
+        if (valid)
+        {
+            break;
+        }
+        series = series_at(ref, radius, series.skip / 2);
+    }
+    return series;
+}
+
+// Iterates one pixel at dc from the reference, starting at iteration start
+// with the delta dz. Returns the count the same way escape_time() does;
+// glitch is set to |z|^2 / |Z|^2 when the pixel glitched, smaller meaning
+// closer to the feature that caused it.
+static uint32_t perturbed_escape_time(const ReferenceOrbit &ref, double dcr, double dci, uint32_t start, std::complex<double> dz, uint32_t max_iteration, double bailout, double &glitch)
+{
+    const double *zr = ref.zr.data();
+    const double *zi = ref.zi.data();
+    uint32_t last = uint32_t(ref.zr.size() - 1);
+
+    double dzr = dz.real(), dzi = dz.imag();
+    for (uint32_t i = start; i < max_iteration; i++)
+    {
+        if (i == last)
+        {
+            // the reference escaped while this pixel is still going
+            glitch = 1.0;
+            return i;
+        }
+
+        double ndzr = 2.0 * (zr[i] * dzr - zi[i] * dzi) + (dzr * dzr - dzi * dzi) + dcr;
+        double ndzi = 2.0 * (zr[i] * dzi + zi[i] * dzr) + 2.0 * dzr * dzi + dci;
+        dzr = ndzr;
+        dzi = ndzi;
+
+        double x = zr[i + 1] + dzr;
+        double y = zi[i + 1] + dzi;
+        double magnitude = x * x + y * y;
+        if (magnitude > bailout)
+        {
+            return i;
+        }
+        double ref_magnitude = zr[i + 1] * zr[i + 1] + zi[i + 1] * zi[i + 1];
+        if (magnitude < GLITCH_TOLERANCE * ref_magnitude)
+        {
+            glitch = magnitude / ref_magnitude;
+            return i;
+        }
+    }
+    return max_iteration;
+}
+
+PerturbationReference perturbation_reference(const DoubleDouble &x0, const DoubleDouble &y0, double step, int width, int height, const FractalParams &params, bool use_series)
+{
+    int fraction_limbs = big_fixed_fraction_limbs(step);
+    int ref_x = width / 2, ref_y = height / 2;
+    BigFixed cr = big_fixed(x0, fraction_limbs) + big_fixed(ref_x * step, fraction_limbs);
+    BigFixed ci = big_fixed(y0, fraction_limbs) + big_fixed(ref_y * step, fraction_limbs);
+    PerturbationReference reference;
+    reference.orbit = reference_orbit(cr, ci, params);
+    if (use_series)
+    {
+        double radius = std::hypot(std::max(ref_x, width - ref_x), std::max(ref_y, height - ref_y)) * step;
+        reference.series = series_approximation(reference.orbit, radius, step, params);
+    }
+    return reference;
+}
+
+// Pixels per task when a pass is split between threads
+constexpr int PERTURBATION_TASK_PIXELS = 4096;
+
+// Results of one task of a pass
+struct PerturbationTask
+{
+    uint64_t iterations = 0;
+    std::vector<int> glitched;
+    int next_ref = -1;
+    double next_glitch = 0.0;
+};
+
+template <typename Count>
+PerturbationStats mandelbrot_perturbation(const DoubleDouble &x0, const DoubleDouble &y0, double step, Count *bitmap, Count *period, int width, int height, const FractalParams &params, bool use_series, ThreadPool *pool, JobGeneration job, const std::vector<int> *pixels, const PerturbationReference *reference)
+{
+    PerturbationStats stats;
+    double bailout = params.escape_radius * params.escape_radius;
+    int fraction_limbs = big_fixed_fraction_limbs(step);
+    BigFixed origin_x = big_fixed(x0, fraction_limbs);
+    BigFixed origin_y = big_fixed(y0, fraction_limbs);
+
+    // pixels still to be (re)computed, all of them against the first
+    // reference
+    std::vector<int> pending;
+    if (pixels)
+    {
+        pending = *pixels;
+    }
+    else
+    {
+        pending.resize(width * height);
+        std::iota(pending.begin(), pending.end(), 0);
+    }
+    int ref_x = width / 2, ref_y = height / 2;
+    std::optional<PerturbationReference> own_reference;
+
+    while (!pending.empty() && stats.references < MAX_REFERENCES)
+    {
+        // Only the first reference covers the whole frame, and only then is
+        // the series worth computing. Pixels recomputed against later
+        // references start from dz_0 = dc.
+        const ReferenceOrbit *ref;
+        ReferenceOrbit later_ref;
+        SeriesApproximation series;
+        if (stats.references == 0)
+        {
+            if (!reference)
+            {
+                own_reference = perturbation_reference(x0, y0, step, width, height, params, use_series);
+                reference = &*own_reference;
+            }
+            ref = &reference->orbit;
+            series = reference->series;
+            stats.series_skip = series.skip;
+        }
+        else
+        {
+            BigFixed cr = origin_x + big_fixed(ref_x * step, fraction_limbs);
+            BigFixed ci = origin_y + big_fixed(ref_y * step, fraction_limbs);
+            later_ref = reference_orbit(cr, ci, params);
+            ref = &later_ref;
+        }
+        stats.references++;
+
+        // Each task keeps its own glitched pixels and deepest glitch. They
+        // are merged in task order, so the next reference does not depend on
+        // how the tasks were spread over threads.
+        int task_n = (int(pending.size()) + PERTURBATION_TASK_PIXELS - 1) / PERTURBATION_TASK_PIXELS;
+        std::vector<PerturbationTask> tasks(task_n);
+        auto run_tasks = [&](int begin, int end) {
+            for (int t = begin; t < end; t++)
+            {
+                PerturbationTask &task = tasks[t];
+                int first = t * PERTURBATION_TASK_PIXELS;
+                int last = std::min(first + PERTURBATION_TASK_PIXELS, int(pending.size()));
+                for (int k = first; k < last; k++)
+                {
+                    int i = pending[k];
+                    double dcr = (i % width - ref_x) * step;
+                    double dci = (i / width - ref_y) * step;
+                    double glitch = -1.0;
+                    std::complex<double> dz = series.skip ? evaluate(series, {dcr, dci}) : std::complex<double>{dcr, dci};
+                    uint32_t count = perturbed_escape_time(*ref, dcr, dci, series.skip, dz, params.max_iteration, bailout, glitch);
+                    bitmap[i] = Count(count);
+                    task.iterations += count - series.skip;
+                    if (glitch >= 0.0)
+                    {
+                        task.glitched.push_back(i);
+                        // the deepest glitch is nearest to the feature the
+                        // current reference misses, so it makes the best
+                        // next reference
+                        if (task.next_ref < 0 || glitch < task.next_glitch)
+                        {
+                            task.next_ref = i;
+                            task.next_glitch = glitch;
+                        }
+                    }
+                }
+            }
+        };
+        if (pool)
+        {
+            if (!pool->parallel_for(task_n, 1, run_tasks, job))
+            {
+                break;
+            }
+        }
+        else
+        {
+            run_tasks(0, task_n);
+        }
+
+        std::vector<int> glitched;
+        int next_ref = -1;
+        double next_glitch = 0.0;
+        for (const PerturbationTask &task : tasks)
+        {
+            stats.kernel.iterations += task.iterations;
+            glitched.insert(glitched.end(), task.glitched.begin(), task.glitched.end());
+            if (task.next_ref >= 0 && (next_ref < 0 || task.next_glitch < next_glitch))
+            {
+                next_ref = task.next_ref;
+                next_glitch = task.next_glitch;
+            }
+        }
+
+        pending.swap(glitched);
+        if (next_ref >= 0)
+        {
+            ref_x = next_ref % width;
+            ref_y = next_ref / width;
+        }
+    }
+    stats.glitched = pending.size();
+
+    if (period && pixels)
+    {
+        for (int i : *pixels)
+        {
+            period[i] = 0;
+        }
+    }
+    else if (period)
+    {
+        std::fill(period, period + width * height, 0);
+    }
+    return stats;
+}
+
+// perturbed frames in each of the count types of count_type()
+template PerturbationStats mandelbrot_perturbation(const DoubleDouble &, const DoubleDouble &, double, uint8_t *, uint8_t *, int, int, const FractalParams &, bool, ThreadPool *, JobGeneration, const std::vector<int> *, const PerturbationReference *);
+template PerturbationStats mandelbrot_perturbation(const DoubleDouble &, const DoubleDouble &, double, uint16_t *, uint16_t *, int, int, const FractalParams &, bool, ThreadPool *, JobGeneration, const std::vector<int> *, const PerturbationReference *);
+template PerturbationStats mandelbrot_perturbation(const DoubleDouble &, const DoubleDouble &, double, uint32_t *, uint32_t *, int, int, const FractalParams &, bool, ThreadPool *, JobGeneration, const std::vector<int> *, const PerturbationReference *);
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+#include "fractal.h"
+#include "double_double.h"
+#include "big_fixed.h"
+#include "thread_pool.h"
+
+// Deep zoom renderer based on perturbation theory. One reference point C is
+// iterated in BigFixed; every pixel c = C + dc then only iterates its
+// difference to the reference orbit in double:
+//
+//     dz_{n+1} = 2 Z_n dz_n + dz_n^2 + dc
+//
+// which keeps its relative precision however deep the zoom is.
+
+// Reference orbit Z_0 = C, Z_1, ... up to the point that escaped or up to
+// max_iteration, rounded to double.
+struct ReferenceOrbit
+{
+    std::vector<double> zr;
+    std::vector<double> zi;
+};
+
+ReferenceOrbit reference_orbit(const BigFixed &cr, const BigFixed &ci, const FractalParams &params);
+
+// A pixel is glitched once |Z + dz|^2 < GLITCH_TOLERANCE * |Z|^2: the delta
+// has cancelled the reference and its rounding error dominates
+// (Pauldelbrot's criterion).
+constexpr double GLITCH_TOLERANCE = 1e-6;
+
+// New references tried per frame before the pixels still glitched are left
+// with the count they had when the glitch was detected.
+constexpr int MAX_REFERENCES = 32;
+
+// BigFixed has a 32-bit integer part, which the reference orbit has to stay
+// inside of before it escapes.
+constexpr double PERTURBATION_MAX_ESCAPE_RADIUS = 1024.0;
+
+inline bool perturbation_supported(const FractalParams &params)
+{
+    return params.escape_radius <= PERTURBATION_MAX_ESCAPE_RADIUS;
+}
+
+// Series approximation of the delta orbit in powers of dc,
+//     dz_n = a_1 dc + a_2 dc^2 + ... + a_K dc^K,
+// evaluated once per pixel in place of the first `skip` iterations. The
+// coefficients are stored scaled by the frame radius (s_k = a_k radius^k)
+// so they stay in range however small dc gets.
+constexpr int SERIES_TERMS = 8;
+
+// The series error may be at most this fraction of the difference in dz
+// between neighbouring pixels. Far below anything visible, because pixels
+// near the boundary amplify it over the iterations that follow.
+constexpr double SERIES_TOLERANCE = 1e-9;
+
+struct SeriesApproximation
+{
+    uint32_t skip = 0;
+    double scale = 1.0;
+    std::complex<double> coefficients[SERIES_TERMS] = {};
+};
+
+// Picks skip for a frame of the given radius around the reference: as many
+// iterations as the truncation bound allows, then fewer until the series
+// agrees with plain perturbation at points on the frame edge.
+SeriesApproximation series_approximation(const ReferenceOrbit &ref, double radius, double step, const FractalParams &params);
+
+// dz_skip for a pixel at dc from the reference
+std::complex<double> evaluate(const SeriesApproximation &series, std::complex<double> dc);
+
+// The first reference of a frame, at its center pixel, with the series
+// approximation around it. Neither depends on which pixels of the frame are
+// computed, so a frame rendered in several passes makes them once.
+struct PerturbationReference
+{
+    ReferenceOrbit orbit;
+    SeriesApproximation series;
+};
+
+// Made for the grid of mandelbrot_perturbation(). The series is left empty
+// unless use_series is on.
+PerturbationReference perturbation_reference(const DoubleDouble &x0, const DoubleDouble &y0, double step, int width, int height, const FractalParams &params, bool use_series = true);
+
+struct PerturbationStats
+{
+    KernelStats kernel;
+    int references = 0;
+    // iterations every pixel skipped through the series approximation
+    uint32_t series_skip = 0;
+    // pixels still glitched after the last reference
+    uint64_t glitched = 0;
+};
+
+// Mandelbrot over a width x height grid, pixel (x, y) at
+// (x0 + x * step, y0 + y * step) like escape_time_grid(). The first
+// reference is the center pixel, later ones are picked among the glitched
+// pixels. Pixels against the first reference start after the series
+// approximation unless use_series is off. No interior test or cycle
+// detection; period (may be null) is filled with 0. With a pool the pixels
+// of each pass are split between its threads, with the same result as
+// without, and the render stops early once job turns stale. pixels (may be
+// null for all of them) lists the pixels to compute, in increasing order.
+// reference (may be null) is the frame's first reference, made with the
+// same use_series. Count is as in subdivide_tile().
+template <typename Count>
+PerturbationStats mandelbrot_perturbation(const DoubleDouble &x0, const DoubleDouble &y0, double step, Count *bitmap, Count *period, int width, int height, const FractalParams &params, bool use_series = true, ThreadPool *pool = nullptr, JobGeneration job = {}, const std::vector<int> *pixels = nullptr, const PerturbationReference *reference = nullptr);
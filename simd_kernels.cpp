@@ -0,0 +1,979 @@
+#include "simd_kernels.h"
+
+// hipcc compiles this file for the device as well; the kernels below are
+// host-only and use x86 intrinsics, so only build them in the host pass.
+#if !defined(__HIP_DEVICE_COMPILE__)
+
+#include <immintrin.h>
+
+// Lanes past the end of the input are padded with a point that escapes on
+// the first iteration (for the default radius), so the tail group costs a
+// single step.
+constexpr double PAD_COORD = 4.0;
+
+const char *isa_name(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::sse42:
+        return "sse4.2";
+    case Isa::avx2:
+        return "avx2";
+    case Isa::avx512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
+
+bool parse_isa(const std::string &name, Isa &isa)
+{
+    for (Isa candidate : {Isa::scalar, Isa::sse42, Isa::avx2, Isa::avx512})
+    {
+        if (name == isa_name(candidate))
+        {
+            isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isa_supported(Isa isa)
+{
+    __builtin_cpu_init();
+    switch (isa)
+    {
+    case Isa::sse42:
+        return __builtin_cpu_supports("sse4.2");
+    case Isa::avx2:
+        return __builtin_cpu_supports("avx2");
+    case Isa::avx512:
+        return __builtin_cpu_supports("avx512f");
+    default:
+        return true;
+    }
+}
+
+Isa detect_isa()
+{
+    for (Isa isa : {Isa::avx512, Isa::avx2, Isa::sse42})
+    {
+        if (isa_supported(isa))
+        {
+            return isa;
+        }
+    }
+    return Isa::scalar;
+}
+
+// Loop settings taken out of FractalParams once per call
+struct LoopParams
+{
+    uint32_t max_iteration;
+    double bailout;
+    double tolerance;
+};
+
+static inline LoopParams loop_params(const FractalParams &params)
+{
+    return {params.max_iteration, params.escape_radius * params.escape_radius, params.periodicity_tolerance};
+}
+
+// Per-lane results of one lane group, before they are written out. Lane is
+// the integer type matching the width of Real (int64_t for double lanes,
+// int32_t for float lanes).
+template <typename Lane>
+struct LaneResult
+{
+    Lane count[16];
+    Lane period[16];
+    // lanes answered analytically (cardioid, period-2 bulb) or by a cycle
+    int cardioid_bits = 0;
+    int bulb_bits = 0;
+    int periodic_bits = 0;
+};
+
+template <typename Lane, typename Count>
+static inline KernelStats store_lanes(const LaneResult<Lane> &r, uint32_t max_iteration, Count *bitmap, Count *period, int lanes)
+{
+    KernelStats stats;
+    for (int l = 0; l < lanes; l++)
+    {
+        uint32_t p = 0;
+        if (r.cardioid_bits >> l & 1)
+        {
+            p = 1;
+            stats.skipped++;
+        }
+        else if (r.bulb_bits >> l & 1)
+        {
+            p = 2;
+            stats.skipped++;
+        }
+        else if (r.periodic_bits >> l & 1)
+        {
+            p = uint32_t(r.period[l]);
+            stats.periodic++;
+        }
+        else
+        {
+            stats.iterations += r.count[l];
+        }
+
+        bitmap[l] = Count(p ? max_iteration : uint32_t(r.count[l]));
+        if (period)
+        {
+            period[l] = Count(p);
+        }
+    }
+    return stats;
+}
+
+// Lane helpers shared by the double kernels below. For each ISA:
+//   inside_*   cardioid / period-2 bulb test, same expressions as
+//              cardioid_or_bulb_period(); returns the cardioid lanes and
+//              sets the lanes only in the bulb
+//   iterate_*  z = z^2 + c on the active lanes until all of them escaped,
+//              ran into a cycle or hit max_iteration, with the same Brent
+//              schedule as escape_time()
+
+__attribute__((target("sse4.2")))
+static inline __m128d inside_sse42(__m128d x, __m128d y, __m128d &bulb)
+{
+    __m128d y2 = _mm_mul_pd(y, y);
+    __m128d xq = _mm_sub_pd(x, _mm_set1_pd(0.25));
+    __m128d q = _mm_add_pd(_mm_mul_pd(xq, xq), y2);
+    __m128d cardioid = _mm_cmple_pd(_mm_mul_pd(q, _mm_add_pd(q, xq)), _mm_mul_pd(_mm_set1_pd(0.25), y2));
+    __m128d xb = _mm_add_pd(x, _mm_set1_pd(1.0));
+    bulb = _mm_andnot_pd(cardioid, _mm_cmple_pd(_mm_add_pd(_mm_mul_pd(xb, xb), y2), _mm_set1_pd(0.0625)));
+    return cardioid;
+}
+
+__attribute__((target("sse4.2")))
+static inline void iterate_sse42(__m128d x, __m128d y, __m128d cr, __m128d ci, __m128d active, const LoopParams &lp, LaneResult<int64_t> &r)
+{
+    const __m128d vbailout = _mm_set1_pd(lp.bailout);
+    const __m128d vtolerance = _mm_set1_pd(lp.tolerance);
+    const __m128d sign = _mm_set1_pd(-0.0);
+    const bool check_period = lp.tolerance > 0;
+    __m128d x2 = _mm_mul_pd(x, x);
+    __m128d y2 = _mm_mul_pd(y, y);
+    __m128i count = _mm_setzero_si128();
+
+    __m128d saved_x = x, saved_y = y;
+    uint32_t saved_at = 0, next_save = 1;
+    __m128d periodic = _mm_setzero_pd();
+    __m128i period = _mm_setzero_si128();
+
+    for (uint32_t i = 0; i < lp.max_iteration; i++)
+    {
+        y = _mm_add_pd(_mm_mul_pd(_mm_add_pd(x, x), y), ci);
+        x = _mm_add_pd(_mm_sub_pd(x2, y2), cr);
+        x2 = _mm_mul_pd(x, x);
+        y2 = _mm_mul_pd(y, y);
+
+        __m128d escaped = _mm_cmpgt_pd(_mm_add_pd(x2, y2), vbailout);
+        active = _mm_andnot_pd(escaped, active);
+
+        if (check_period)
+        {
+            if (saved_at > 0)
+            {
+                __m128d dx = _mm_andnot_pd(sign, _mm_sub_pd(x, saved_x));
+                __m128d dy = _mm_andnot_pd(sign, _mm_sub_pd(y, saved_y));
+                __m128d found = _mm_and_pd(active, _mm_and_pd(_mm_cmplt_pd(dx, vtolerance), _mm_cmplt_pd(dy, vtolerance)));
+                if (_mm_movemask_pd(found))
+                {
+                    periodic = _mm_or_pd(periodic, found);
+                    period = _mm_blendv_epi8(period, _mm_set1_epi64x(i + 1 - saved_at), _mm_castpd_si128(found));
+                    active = _mm_andnot_pd(found, active);
+                }
+            }
+            if (i + 1 == next_save)
+            {
+                saved_x = x;
+                saved_y = y;
+                saved_at = i + 1;
+                next_save *= 2;
+            }
+        }
+
+        if (_mm_movemask_pd(active) == 0)
+        {
+            break;
+        }
+        // active lanes are -1, so subtracting counts one more iteration
+        count = _mm_sub_epi64(count, _mm_castpd_si128(active));
+    }
+
+    _mm_storeu_si128((__m128i *)r.count, count);
+    _mm_storeu_si128((__m128i *)r.period, period);
+    r.periodic_bits = _mm_movemask_pd(periodic);
+}
+
+__attribute__((target("sse4.2")))
+static inline void load_sse42(const double *r, const double *i, int lanes, __m128d &vr, __m128d &vi)
+{
+    if (lanes == 2)
+    {
+        vr = _mm_loadu_pd(r);
+        vi = _mm_loadu_pd(i);
+        return;
+    }
+    vr = _mm_set_pd(PAD_COORD, r[0]);
+    vi = _mm_set_pd(PAD_COORD, i[0]);
+}
+
+template <typename Count>
+__attribute__((target("sse4.2")))
+static KernelStats mandelbrot_sse42(const double *cr, const double *ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    const LoopParams lp = loop_params(params);
+    const bool interior_test = use_interior_test(params);
+    const __m128d all = _mm_castsi128_pd(_mm_set1_epi64x(-1));
+    KernelStats stats;
+    for (int base = 0; base < n; base += 2)
+    {
+        int lanes = n - base < 2 ? n - base : 2;
+        __m128d x0, y0;
+        load_sse42(cr + base, ci + base, lanes, x0, y0);
+        __m128d cardioid = _mm_setzero_pd(), bulb = _mm_setzero_pd();
+        if (interior_test)
+        {
+            cardioid = inside_sse42(x0, y0, bulb);
+        }
+        LaneResult<int64_t> r;
+        iterate_sse42(x0, y0, x0, y0, _mm_andnot_pd(_mm_or_pd(cardioid, bulb), all), lp, r);
+        r.cardioid_bits = _mm_movemask_pd(cardioid);
+        r.bulb_bits = _mm_movemask_pd(bulb);
+        stats += store_lanes(r, lp.max_iteration, bitmap + base, period ? period + base : nullptr, lanes);
+    }
+    return stats;
+}
+
+template <typename Count>
+__attribute__((target("sse4.2")))
+static KernelStats julia_sse42(const double *xr, const double *xi, double cr, double ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    const LoopParams lp = loop_params(params);
+    const __m128d vcr = _mm_set1_pd(cr);
+    const __m128d vci = _mm_set1_pd(ci);
+    const __m128d all = _mm_castsi128_pd(_mm_set1_epi64x(-1));
+    KernelStats stats;
+    for (int base = 0; base < n; base += 2)
+    {
+        int lanes = n - base < 2 ? n - base : 2;
+        __m128d x, y;
+        load_sse42(xr + base, xi + base, lanes, x, y);
+        LaneResult<int64_t> r;
+        iterate_sse42(x, y, vcr, vci, all, lp, r);
+        stats += store_lanes(r, lp.max_iteration, bitmap + base, period ? period + base : nullptr, lanes);
+    }
+    return stats;
+}
+
+__attribute__((target("avx2")))
+static inline __m256d inside_avx2(__m256d x, __m256d y, __m256d &bulb)
+{
+    __m256d y2 = _mm256_mul_pd(y, y);
+    __m256d xq = _mm256_sub_pd(x, _mm256_set1_pd(0.25));
+    __m256d q = _mm256_add_pd(_mm256_mul_pd(xq, xq), y2);
+    __m256d cardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, xq)), _mm256_mul_pd(_mm256_set1_pd(0.25), y2), _CMP_LE_OQ);
+    __m256d xb = _mm256_add_pd(x, _mm256_set1_pd(1.0));
+    bulb = _mm256_andnot_pd(cardioid, _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(xb, xb), y2), _mm256_set1_pd(0.0625), _CMP_LE_OQ));
+    return cardioid;
+}
+
+__attribute__((target("avx2")))
+static inline void iterate_avx2(__m256d x, __m256d y, __m256d cr, __m256d ci, __m256d active, const LoopParams &lp, LaneResult<int64_t> &r)
+{
+    const __m256d vbailout = _mm256_set1_pd(lp.bailout);
+    const __m256d vtolerance = _mm256_set1_pd(lp.tolerance);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const bool check_period = lp.tolerance > 0;
+    __m256d x2 = _mm256_mul_pd(x, x);
+    __m256d y2 = _mm256_mul_pd(y, y);
+    __m256i count = _mm256_setzero_si256();
+
+    __m256d saved_x = x, saved_y = y;
+    uint32_t saved_at = 0, next_save = 1;
+    __m256d periodic = _mm256_setzero_pd();
+    __m256i period = _mm256_setzero_si256();
+
+    for (uint32_t i = 0; i < lp.max_iteration; i++)
+    {
+        y = _mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(x, x), y), ci);
+        x = _mm256_add_pd(_mm256_sub_pd(x2, y2), cr);
+        x2 = _mm256_mul_pd(x, x);
+        y2 = _mm256_mul_pd(y, y);
+
+        __m256d escaped = _mm256_cmp_pd(_mm256_add_pd(x2, y2), vbailout, _CMP_GT_OQ);
+        active = _mm256_andnot_pd(escaped, active);
+
+        if (check_period)
+        {
+            if (saved_at > 0)
+            {
+                __m256d dx = _mm256_andnot_pd(sign, _mm256_sub_pd(x, saved_x));
+                __m256d dy = _mm256_andnot_pd(sign, _mm256_sub_pd(y, saved_y));
+                __m256d close = _mm256_and_pd(_mm256_cmp_pd(dx, vtolerance, _CMP_LT_OQ), _mm256_cmp_pd(dy, vtolerance, _CMP_LT_OQ));
+                __m256d found = _mm256_and_pd(active, close);
+                if (_mm256_movemask_pd(found))
+                {
+                    periodic = _mm256_or_pd(periodic, found);
+                    period = _mm256_blendv_epi8(period, _mm256_set1_epi64x(i + 1 - saved_at), _mm256_castpd_si256(found));
+                    active = _mm256_andnot_pd(found, active);
+                }
+            }
+            if (i + 1 == next_save)
+            {
+                saved_x = x;
+                saved_y = y;
+                saved_at = i + 1;
+                next_save *= 2;
+            }
+        }
+
+        if (_mm256_movemask_pd(active) == 0)
+        {
+            break;
+        }
+        count = _mm256_sub_epi64(count, _mm256_castpd_si256(active));
+    }
+
+    _mm256_storeu_si256((__m256i *)r.count, count);
+    _mm256_storeu_si256((__m256i *)r.period, period);
+    r.periodic_bits = _mm256_movemask_pd(periodic);
+}
+
+__attribute__((target("avx2")))
+static inline void load_avx2(const double *r, const double *i, int lanes, __m256d &vr, __m256d &vi)
+{
+    if (lanes == 4)
+    {
+        vr = _mm256_loadu_pd(r);
+        vi = _mm256_loadu_pd(i);
+        return;
+    }
+    alignas(32) double r_in[4] = {PAD_COORD, PAD_COORD, PAD_COORD, PAD_COORD};
+    alignas(32) double i_in[4] = {PAD_COORD, PAD_COORD, PAD_COORD, PAD_COORD};
+    for (int l = 0; l < lanes; l++)
+    {
+        r_in[l] = r[l];
+        i_in[l] = i[l];
+    }
+    vr = _mm256_load_pd(r_in);
+    vi = _mm256_load_pd(i_in);
+}
+
+template <typename Count>
+__attribute__((target("avx2")))
+static KernelStats mandelbrot_avx2(const double *cr, const double *ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    const LoopParams lp = loop_params(params);
+    const bool interior_test = use_interior_test(params);
+    const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    KernelStats stats;
+    for (int base = 0; base < n; base += 4)
+    {
+        int lanes = n - base < 4 ? n - base : 4;
+        __m256d x0, y0;
+        load_avx2(cr + base, ci + base, lanes, x0, y0);
+        __m256d cardioid = _mm256_setzero_pd(), bulb = _mm256_setzero_pd();
+        if (interior_test)
+        {
+            cardioid = inside_avx2(x0, y0, bulb);
+        }
+        LaneResult<int64_t> r;
+        iterate_avx2(x0, y0, x0, y0, _mm256_andnot_pd(_mm256_or_pd(cardioid, bulb), all), lp, r);
+        r.cardioid_bits = _mm256_movemask_pd(cardioid);
+        r.bulb_bits = _mm256_movemask_pd(bulb);
+        stats += store_lanes(r, lp.max_iteration, bitmap + base, period ? period + base : nullptr, lanes);
+    }
+    return stats;
+}
+
+template <typename Count>
+__attribute__((target("avx2")))
+static KernelStats julia_avx2(const double *xr, const double *xi, double cr, double ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    const LoopParams lp = loop_params(params);
+    const __m256d vcr = _mm256_set1_pd(cr);
+    const __m256d vci = _mm256_set1_pd(ci);
+    const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    KernelStats stats;
+    for (int base = 0; base < n; base += 4)
+    {
+        int lanes = n - base < 4 ? n - base : 4;
+        __m256d x, y;
+        load_avx2(xr + base, xi + base, lanes, x, y);
+        LaneResult<int64_t> r;
+        iterate_avx2(x, y, vcr, vci, all, lp, r);
+        stats += store_lanes(r, lp.max_iteration, bitmap + base, period ? period + base : nullptr, lanes);
+    }
+    return stats;
+}
+
+__attribute__((target("avx512f")))
+static inline __mmask8 inside_avx512(__m512d x, __m512d y, __mmask8 &bulb)
+{
+    __m512d y2 = _mm512_mul_pd(y, y);
+    __m512d xq = _mm512_sub_pd(x, _mm512_set1_pd(0.25));
+    __m512d q = _mm512_add_pd(_mm512_mul_pd(xq, xq), y2);
+    __mmask8 cardioid = _mm512_cmp_pd_mask(_mm512_mul_pd(q, _mm512_add_pd(q, xq)), _mm512_mul_pd(_mm512_set1_pd(0.25), y2), _CMP_LE_OQ);
+    __m512d xb = _mm512_add_pd(x, _mm512_set1_pd(1.0));
+    bulb = _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(xb, xb), y2), _mm512_set1_pd(0.0625), _CMP_LE_OQ) & ~cardioid;
+    return cardioid;
+}
+
+__attribute__((target("avx512f")))
+static inline void iterate_avx512(__m512d x, __m512d y, __m512d cr, __m512d ci, __mmask8 active, const LoopParams &lp, LaneResult<int64_t> &r)
+{
+    const __m512d vbailout = _mm512_set1_pd(lp.bailout);
+    const __m512d vtolerance = _mm512_set1_pd(lp.tolerance);
+    const __m512i one = _mm512_set1_epi64(1);
+    const bool check_period = lp.tolerance > 0;
+    __m512d x2 = _mm512_mul_pd(x, x);
+    __m512d y2 = _mm512_mul_pd(y, y);
+    __m512i count = _mm512_setzero_si512();
+
+    __m512d saved_x = x, saved_y = y;
+    uint32_t saved_at = 0, next_save = 1;
+    __mmask8 periodic = 0;
+    __m512i period = _mm512_setzero_si512();
+
+    for (uint32_t i = 0; i < lp.max_iteration; i++)
+    {
+        y = _mm512_add_pd(_mm512_mul_pd(_mm512_add_pd(x, x), y), ci);
+        x = _mm512_add_pd(_mm512_sub_pd(x2, y2), cr);
+        x2 = _mm512_mul_pd(x, x);
+        y2 = _mm512_mul_pd(y, y);
+
+        __mmask8 escaped = _mm512_cmp_pd_mask(_mm512_add_pd(x2, y2), vbailout, _CMP_GT_OQ);
+        active = active & ~escaped;
+
+        if (check_period)
+        {
+            if (saved_at > 0)
+            {
+                __m512d dx = _mm512_abs_pd(_mm512_sub_pd(x, saved_x));
+                __m512d dy = _mm512_abs_pd(_mm512_sub_pd(y, saved_y));
+                __mmask8 found = active & _mm512_cmp_pd_mask(dx, vtolerance, _CMP_LT_OQ) & _mm512_cmp_pd_mask(dy, vtolerance, _CMP_LT_OQ);
+                if (found)
+                {
+                    periodic |= found;
+                    period = _mm512_mask_mov_epi64(period, found, _mm512_set1_epi64(i + 1 - saved_at));
+                    active &= ~found;
+                }
+            }
+            if (i + 1 == next_save)
+            {
+                saved_x = x;
+                saved_y = y;
+                saved_at = i + 1;
+                next_save *= 2;
+            }
+        }
+
+        if (active == 0)
+        {
+            break;
+        }
+        count = _mm512_mask_add_epi64(count, active, count, one);
+    }
+
+    _mm512_storeu_si512(r.count, count);
+    _mm512_storeu_si512(r.period, period);
+    r.periodic_bits = periodic;
+}
+
+template <typename Count>
+__attribute__((target("avx512f")))
+static KernelStats mandelbrot_avx512(const double *cr, const double *ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    const LoopParams lp = loop_params(params);
+    const bool interior_test = use_interior_test(params);
+    const __m512d pad = _mm512_set1_pd(PAD_COORD);
+    KernelStats stats;
+    for (int base = 0; base < n; base += 8)
+    {
+        int lanes = n - base < 8 ? n - base : 8;
+        __mmask8 valid = __mmask8((1u << lanes) - 1);
+        __m512d x0 = _mm512_mask_loadu_pd(pad, valid, cr + base);
+        __m512d y0 = _mm512_mask_loadu_pd(pad, valid, ci + base);
+        __mmask8 cardioid = 0, bulb = 0;
+        if (interior_test)
+        {
+            cardioid = inside_avx512(x0, y0, bulb);
+        }
+        LaneResult<int64_t> r;
+        iterate_avx512(x0, y0, x0, y0, __mmask8(~(cardioid | bulb)), lp, r);
+        r.cardioid_bits = cardioid;
+        r.bulb_bits = bulb;
+        stats += store_lanes(r, lp.max_iteration, bitmap + base, period ? period + base : nullptr, lanes);
+    }
+    return stats;
+}
+
+template <typename Count>
+__attribute__((target("avx512f")))
+static KernelStats julia_avx512(const double *xr, const double *xi, double cr, double ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    const LoopParams lp = loop_params(params);
+    const __m512d pad = _mm512_set1_pd(PAD_COORD);
+    const __m512d vcr = _mm512_set1_pd(cr);
+    const __m512d vci = _mm512_set1_pd(ci);
+    KernelStats stats;
+    for (int base = 0; base < n; base += 8)
+    {
+        int lanes = n - base < 8 ? n - base : 8;
+        __mmask8 valid = __mmask8((1u << lanes) - 1);
+        __m512d x = _mm512_mask_loadu_pd(pad, valid, xr + base);
+        __m512d y = _mm512_mask_loadu_pd(pad, valid, xi + base);
+        LaneResult<int64_t> r;
+        iterate_avx512(x, y, vcr, vci, 0xFF, lp, r);
+        stats += store_lanes(r, lp.max_iteration, bitmap + base, period ? period + base : nullptr, lanes);
+    }
+    return stats;
+}
+
+// Float kernels. Same structure as the double ones with twice the lanes; the
+// coordinate map stays in double and is rounded to float on load, the same
+// way escape_time_span<float> does it.
+
+__attribute__((target("sse4.2")))
+static inline __m128 inside_sse42(__m128 x, __m128 y, __m128 &bulb)
+{
+    __m128 y2 = _mm_mul_ps(y, y);
+    __m128 xq = _mm_sub_ps(x, _mm_set1_ps(0.25f));
+    __m128 q = _mm_add_ps(_mm_mul_ps(xq, xq), y2);
+    __m128 cardioid = _mm_cmple_ps(_mm_mul_ps(q, _mm_add_ps(q, xq)), _mm_mul_ps(_mm_set1_ps(0.25f), y2));
+    __m128 xb = _mm_add_ps(x, _mm_set1_ps(1.0f));
+    bulb = _mm_andnot_ps(cardioid, _mm_cmple_ps(_mm_add_ps(_mm_mul_ps(xb, xb), y2), _mm_set1_ps(0.0625f)));
+    return cardioid;
+}
+
+__attribute__((target("sse4.2")))
+static inline void iterate_sse42(__m128 x, __m128 y, __m128 cr, __m128 ci, __m128 active, const LoopParams &lp, LaneResult<int32_t> &r)
+{
+    const __m128 vbailout = _mm_set1_ps(float(lp.bailout));
+    const __m128 vtolerance = _mm_set1_ps(float(lp.tolerance));
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const bool check_period = float(lp.tolerance) > 0;
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 y2 = _mm_mul_ps(y, y);
+    __m128i count = _mm_setzero_si128();
+
+    __m128 saved_x = x, saved_y = y;
+    uint32_t saved_at = 0, next_save = 1;
+    __m128 periodic = _mm_setzero_ps();
+    __m128i period = _mm_setzero_si128();
+
+    for (uint32_t i = 0; i < lp.max_iteration; i++)
+    {
+        y = _mm_add_ps(_mm_mul_ps(_mm_add_ps(x, x), y), ci);
+        x = _mm_add_ps(_mm_sub_ps(x2, y2), cr);
+        x2 = _mm_mul_ps(x, x);
+        y2 = _mm_mul_ps(y, y);
+
+        __m128 escaped = _mm_cmpgt_ps(_mm_add_ps(x2, y2), vbailout);
+        active = _mm_andnot_ps(escaped, active);
+
+        if (check_period)
+        {
+            if (saved_at > 0)
+            {
+                __m128 dx = _mm_andnot_ps(sign, _mm_sub_ps(x, saved_x));
+                __m128 dy = _mm_andnot_ps(sign, _mm_sub_ps(y, saved_y));
+                __m128 found = _mm_and_ps(active, _mm_and_ps(_mm_cmplt_ps(dx, vtolerance), _mm_cmplt_ps(dy, vtolerance)));
+                if (_mm_movemask_ps(found))
+                {
+                    periodic = _mm_or_ps(periodic, found);
+                    period = _mm_blendv_epi8(period, _mm_set1_epi32(i + 1 - saved_at), _mm_castps_si128(found));
+                    active = _mm_andnot_ps(found, active);
+                }
+            }
+            if (i + 1 == next_save)
+            {
+                saved_x = x;
+                saved_y = y;
+                saved_at = i + 1;
+                next_save *= 2;
+            }
+        }
+
+        if (_mm_movemask_ps(active) == 0)
+        {
+            break;
+        }
+        count = _mm_sub_epi32(count, _mm_castps_si128(active));
+    }
+
+    _mm_storeu_si128((__m128i *)r.count, count);
+    _mm_storeu_si128((__m128i *)r.period, period);
+    r.periodic_bits = _mm_movemask_ps(periodic);
+}
+
+__attribute__((target("sse4.2")))
+static inline void load_sse42(const double *r, const double *i, int lanes, __m128 &vr, __m128 &vi)
+{
+    if (lanes == 4)
+    {
+        vr = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(r)), _mm_cvtpd_ps(_mm_loadu_pd(r + 2)));
+        vi = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(i)), _mm_cvtpd_ps(_mm_loadu_pd(i + 2)));
+        return;
+    }
+    alignas(16) float r_in[4] = {PAD_COORD, PAD_COORD, PAD_COORD, PAD_COORD};
+    alignas(16) float i_in[4] = {PAD_COORD, PAD_COORD, PAD_COORD, PAD_COORD};
+    for (int l = 0; l < lanes; l++)
+    {
+        r_in[l] = float(r[l]);
+        i_in[l] = float(i[l]);
+    }
+    vr = _mm_load_ps(r_in);
+    vi = _mm_load_ps(i_in);
+}
+
+template <typename Count>
+__attribute__((target("sse4.2")))
+static KernelStats mandelbrot_sse42_float(const double *cr, const double *ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    const LoopParams lp = loop_params(params);
+    const bool interior_test = use_interior_test(params);
+    const __m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    KernelStats stats;
+    for (int base = 0; base < n; base += 4)
+    {
+        int lanes = n - base < 4 ? n - base : 4;
+        __m128 x0, y0;
+        load_sse42(cr + base, ci + base, lanes, x0, y0);
+        __m128 cardioid = _mm_setzero_ps(), bulb = _mm_setzero_ps();
+        if (interior_test)
+        {
+            cardioid = inside_sse42(x0, y0, bulb);
+        }
+        LaneResult<int32_t> r;
+        iterate_sse42(x0, y0, x0, y0, _mm_andnot_ps(_mm_or_ps(cardioid, bulb), all), lp, r);
+        r.cardioid_bits = _mm_movemask_ps(cardioid);
+        r.bulb_bits = _mm_movemask_ps(bulb);
+        stats += store_lanes(r, lp.max_iteration, bitmap + base, period ? period + base : nullptr, lanes);
+    }
+    return stats;
+}
+
+template <typename Count>
+__attribute__((target("sse4.2")))
+static KernelStats julia_sse42_float(const double *xr, const double *xi, double cr, double ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    const LoopParams lp = loop_params(params);
+    const __m128 vcr = _mm_set1_ps(float(cr));
+    const __m128 vci = _mm_set1_ps(float(ci));
+    const __m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    KernelStats stats;
+    for (int base = 0; base < n; base += 4)
+    {
+        int lanes = n - base < 4 ? n - base : 4;
+        __m128 x, y;
+        load_sse42(xr + base, xi + base, lanes, x, y);
+        LaneResult<int32_t> r;
+        iterate_sse42(x, y, vcr, vci, all, lp, r);
+        stats += store_lanes(r, lp.max_iteration, bitmap + base, period ? period + base : nullptr, lanes);
+    }
+    return stats;
+}
+
+__attribute__((target("avx2")))
+static inline __m256 inside_avx2(__m256 x, __m256 y, __m256 &bulb)
+{
+    __m256 y2 = _mm256_mul_ps(y, y);
+    __m256 xq = _mm256_sub_ps(x, _mm256_set1_ps(0.25f));
+    __m256 q = _mm256_add_ps(_mm256_mul_ps(xq, xq), y2);
+    __m256 cardioid = _mm256_cmp_ps(_mm256_mul_ps(q, _mm256_add_ps(q, xq)), _mm256_mul_ps(_mm256_set1_ps(0.25f), y2), _CMP_LE_OQ);
+    __m256 xb = _mm256_add_ps(x, _mm256_set1_ps(1.0f));
+    bulb = _mm256_andnot_ps(cardioid, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(xb, xb), y2), _mm256_set1_ps(0.0625f), _CMP_LE_OQ));
+    return cardioid;
+}
+
+__attribute__((target("avx2")))
+static inline void iterate_avx2(__m256 x, __m256 y, __m256 cr, __m256 ci, __m256 active, const LoopParams &lp, LaneResult<int32_t> &r)
+{
+    const __m256 vbailout = _mm256_set1_ps(float(lp.bailout));
+    const __m256 vtolerance = _mm256_set1_ps(float(lp.tolerance));
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const bool check_period = float(lp.tolerance) > 0;
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 y2 = _mm256_mul_ps(y, y);
+    __m256i count = _mm256_setzero_si256();
+
+    __m256 saved_x = x, saved_y = y;
+    uint32_t saved_at = 0, next_save = 1;
+    __m256 periodic = _mm256_setzero_ps();
+    __m256i period = _mm256_setzero_si256();
+
+    for (uint32_t i = 0; i < lp.max_iteration; i++)
+    {
+        y = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(x, x), y), ci);
+        x = _mm256_add_ps(_mm256_sub_ps(x2, y2), cr);
+        x2 = _mm256_mul_ps(x, x);
+        y2 = _mm256_mul_ps(y, y);
+
+        __m256 escaped = _mm256_cmp_ps(_mm256_add_ps(x2, y2), vbailout, _CMP_GT_OQ);
+        active = _mm256_andnot_ps(escaped, active);
+
+        if (check_period)
+        {
+            if (saved_at > 0)
+            {
+                __m256 dx = _mm256_andnot_ps(sign, _mm256_sub_ps(x, saved_x));
+                __m256 dy = _mm256_andnot_ps(sign, _mm256_sub_ps(y, saved_y));
+                __m256 close = _mm256_and_ps(_mm256_cmp_ps(dx, vtolerance, _CMP_LT_OQ), _mm256_cmp_ps(dy, vtolerance, _CMP_LT_OQ));
+                __m256 found = _mm256_and_ps(active, close);
+                if (_mm256_movemask_ps(found))
+                {
+                    periodic = _mm256_or_ps(periodic, found);
+                    period = _mm256_blendv_epi8(period, _mm256_set1_epi32(i + 1 - saved_at), _mm256_castps_si256(found));
+                    active = _mm256_andnot_ps(found, active);
+                }
+            }
+            if (i + 1 == next_save)
+            {
+                saved_x = x;
+                saved_y = y;
+                saved_at = i + 1;
+                next_save *= 2;
+            }
+        }
+
+        if (_mm256_movemask_ps(active) == 0)
+        {
+            break;
+        }
+        count = _mm256_sub_epi32(count, _mm256_castps_si256(active));
+    }
+
+    _mm256_storeu_si256((__m256i *)r.count, count);
+    _mm256_storeu_si256((__m256i *)r.period, period);
+    r.periodic_bits = _mm256_movemask_ps(periodic);
+}
+
+__attribute__((target("avx2")))
+static inline void load_avx2(const double *r, const double *i, int lanes, __m256 &vr, __m256 &vi)
+{
+    if (lanes == 8)
+    {
+        vr = _mm256_set_m128(_mm256_cvtpd_ps(_mm256_loadu_pd(r + 4)), _mm256_cvtpd_ps(_mm256_loadu_pd(r)));
+        vi = _mm256_set_m128(_mm256_cvtpd_ps(_mm256_loadu_pd(i + 4)), _mm256_cvtpd_ps(_mm256_loadu_pd(i)));
+        return;
+    }
+    alignas(32) float r_in[8], i_in[8];
+    for (int l = 0; l < 8; l++)
+    {
+        r_in[l] = l < lanes ? float(r[l]) : float(PAD_COORD);
+        i_in[l] = l < lanes ? float(i[l]) : float(PAD_COORD);
+    }
+    vr = _mm256_load_ps(r_in);
+    vi = _mm256_load_ps(i_in);
+}
+
+template <typename Count>
+__attribute__((target("avx2")))
+static KernelStats mandelbrot_avx2_float(const double *cr, const double *ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    const LoopParams lp = loop_params(params);
+    const bool interior_test = use_interior_test(params);
+    const __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    KernelStats stats;
+    for (int base = 0; base < n; base += 8)
+    {
+        int lanes = n - base < 8 ? n - base : 8;
+        __m256 x0, y0;
+        load_avx2(cr + base, ci + base, lanes, x0, y0);
+        __m256 cardioid = _mm256_setzero_ps(), bulb = _mm256_setzero_ps();
+        if (interior_test)
+        {
+            cardioid = inside_avx2(x0, y0, bulb);
+        }
+        LaneResult<int32_t> r;
+        iterate_avx2(x0, y0, x0, y0, _mm256_andnot_ps(_mm256_or_ps(cardioid, bulb), all), lp, r);
+        r.cardioid_bits = _mm256_movemask_ps(cardioid);
+        r.bulb_bits = _mm256_movemask_ps(bulb);
+        stats += store_lanes(r, lp.max_iteration, bitmap + base, period ? period + base : nullptr, lanes);
+    }
+    return stats;
+}
+
+template <typename Count>
+__attribute__((target("avx2")))
+static KernelStats julia_avx2_float(const double *xr, const double *xi, double cr, double ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    const LoopParams lp = loop_params(params);
+    const __m256 vcr = _mm256_set1_ps(float(cr));
+    const __m256 vci = _mm256_set1_ps(float(ci));
+    const __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    KernelStats stats;
+    for (int base = 0; base < n; base += 8)
+    {
+        int lanes = n - base < 8 ? n - base : 8;
+        __m256 x, y;
+        load_avx2(xr + base, xi + base, lanes, x, y);
+        LaneResult<int32_t> r;
+        iterate_avx2(x, y, vcr, vci, all, lp, r);
+        stats += store_lanes(r, lp.max_iteration, bitmap + base, period ? period + base : nullptr, lanes);
+    }
+    return stats;
+}
+
+__attribute__((target("avx512f")))
+static inline __mmask16 inside_avx512(__m512 x, __m512 y, __mmask16 &bulb)
+{
+    __m512 y2 = _mm512_mul_ps(y, y);
+    __m512 xq = _mm512_sub_ps(x, _mm512_set1_ps(0.25f));
+    __m512 q = _mm512_add_ps(_mm512_mul_ps(xq, xq), y2);
+    __mmask16 cardioid = _mm512_cmp_ps_mask(_mm512_mul_ps(q, _mm512_add_ps(q, xq)), _mm512_mul_ps(_mm512_set1_ps(0.25f), y2), _CMP_LE_OQ);
+    __m512 xb = _mm512_add_ps(x, _mm512_set1_ps(1.0f));
+    bulb = _mm512_cmp_ps_mask(_mm512_add_ps(_mm512_mul_ps(xb, xb), y2), _mm512_set1_ps(0.0625f), _CMP_LE_OQ) & ~cardioid;
+    return cardioid;
+}
+
+__attribute__((target("avx512f")))
+static inline void iterate_avx512(__m512 x, __m512 y, __m512 cr, __m512 ci, __mmask16 active, const LoopParams &lp, LaneResult<int32_t> &r)
+{
+    const __m512 vbailout = _mm512_set1_ps(float(lp.bailout));
+    const __m512 vtolerance = _mm512_set1_ps(float(lp.tolerance));
+    const __m512i one = _mm512_set1_epi32(1);
+    const bool check_period = float(lp.tolerance) > 0;
+    __m512 x2 = _mm512_mul_ps(x, x);
+    __m512 y2 = _mm512_mul_ps(y, y);
+    __m512i count = _mm512_setzero_si512();
+
+    __m512 saved_x = x, saved_y = y;
+    uint32_t saved_at = 0, next_save = 1;
+    __mmask16 periodic = 0;
+    __m512i period = _mm512_setzero_si512();
+
+    for (uint32_t i = 0; i < lp.max_iteration; i++)
+    {
+        y = _mm512_add_ps(_mm512_mul_ps(_mm512_add_ps(x, x), y), ci);
+        x = _mm512_add_ps(_mm512_sub_ps(x2, y2), cr);
+        x2 = _mm512_mul_ps(x, x);
+        y2 = _mm512_mul_ps(y, y);
+
+        __mmask16 escaped = _mm512_cmp_ps_mask(_mm512_add_ps(x2, y2), vbailout, _CMP_GT_OQ);
+        active = active & ~escaped;
+
+        if (check_period)
+        {
+            if (saved_at > 0)
+            {
+                __m512 dx = _mm512_abs_ps(_mm512_sub_ps(x, saved_x));
+                __m512 dy = _mm512_abs_ps(_mm512_sub_ps(y, saved_y));
+                __mmask16 found = active & _mm512_cmp_ps_mask(dx, vtolerance, _CMP_LT_OQ) & _mm512_cmp_ps_mask(dy, vtolerance, _CMP_LT_OQ);
+                if (found)
+                {
+                    periodic |= found;
+                    period = _mm512_mask_mov_epi32(period, found, _mm512_set1_epi32(i + 1 - saved_at));
+                    active &= ~found;
+                }
+            }
+            if (i + 1 == next_save)
+            {
+                saved_x = x;
+                saved_y = y;
+                saved_at = i + 1;
+                next_save *= 2;
+            }
+        }
+
+        if (active == 0)
+        {
+            break;
+        }
+        count = _mm512_mask_add_epi32(count, active, count, one);
+    }
+
+    _mm512_storeu_si512(r.count, count);
+    _mm512_storeu_si512(r.period, period);
+    r.periodic_bits = periodic;
+}
+
+// 16 lanes from two masked double loads; masked-off lanes never touch memory
+__attribute__((target("avx512f")))
+static inline __m512 load_avx512(const double *p, __mmask16 valid)
+{
+    const __m512d pad = _mm512_set1_pd(PAD_COORD);
+    __m256 lo = _mm512_cvtpd_ps(_mm512_mask_loadu_pd(pad, __mmask8(valid), p));
+    __m256 hi = _mm512_cvtpd_ps(_mm512_mask_loadu_pd(pad, __mmask8(valid >> 8), p + 8));
+    return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(lo)), _mm256_castps_pd(hi), 1));
+}
+
+template <typename Count>
+__attribute__((target("avx512f")))
+static KernelStats mandelbrot_avx512_float(const double *cr, const double *ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    const LoopParams lp = loop_params(params);
+    const bool interior_test = use_interior_test(params);
+    KernelStats stats;
+    for (int base = 0; base < n; base += 16)
+    {
+        int lanes = n - base < 16 ? n - base : 16;
+        __mmask16 valid = __mmask16((1u << lanes) - 1);
+        __m512 x0 = load_avx512(cr + base, valid);
+        __m512 y0 = load_avx512(ci + base, valid);
+        __mmask16 cardioid = 0, bulb = 0;
+        if (interior_test)
+        {
+            cardioid = inside_avx512(x0, y0, bulb);
+        }
+        LaneResult<int32_t> r;
+        iterate_avx512(x0, y0, x0, y0, __mmask16(~(cardioid | bulb)), lp, r);
+        r.cardioid_bits = cardioid;
+        r.bulb_bits = bulb;
+        stats += store_lanes(r, lp.max_iteration, bitmap + base, period ? period + base : nullptr, lanes);
+    }
+    return stats;
+}
+
+template <typename Count>
+__attribute__((target("avx512f")))
+static KernelStats julia_avx512_float(const double *xr, const double *xi, double cr, double ci, Count *bitmap, Count *period, int n, const FractalParams &params)
+{
+    const LoopParams lp = loop_params(params);
+    const __m512 vcr = _mm512_set1_ps(float(cr));
+    const __m512 vci = _mm512_set1_ps(float(ci));
+    KernelStats stats;
+    for (int base = 0; base < n; base += 16)
+    {
+        int lanes = n - base < 16 ? n - base : 16;
+        __mmask16 valid = __mmask16((1u << lanes) - 1);
+        __m512 x = load_avx512(xr + base, valid);
+        __m512 y = load_avx512(xi + base, valid);
+        LaneResult<int32_t> r;
+        iterate_avx512(x, y, vcr, vci, 0xFFFF, lp, r);
+        stats += store_lanes(r, lp.max_iteration, bitmap + base, period ? period + base : nullptr, lanes);
+    }
+    return stats;
+}
+
+template <typename Count>
+CpuKernels<Count> simd_kernels(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::sse42:
+        return {mandelbrot_sse42<Count>, julia_sse42<Count>, mandelbrot_sse42_float<Count>, julia_sse42_float<Count>};
+    case Isa::avx2:
+        return {mandelbrot_avx2<Count>, julia_avx2<Count>, mandelbrot_avx2_float<Count>, julia_avx2_float<Count>};
+    case Isa::avx512:
+        return {mandelbrot_avx512<Count>, julia_avx512<Count>, mandelbrot_avx512_float<Count>, julia_avx512_float<Count>};
+    default:
+        return {};
+    }
+}
+
+// the kernels in each of the count types of count_type()
+template CpuKernels<uint8_t> simd_kernels(Isa);
+template CpuKernels<uint16_t> simd_kernels(Isa);
+template CpuKernels<uint32_t> simd_kernels(Isa);
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "fractal.h"
+
+// Instruction sets with a dedicated kernel, narrowest first
+enum class Isa
+{
+    scalar,
+    sse42,
+    avx2,
+    avx512,
+};
+
+const char *isa_name(Isa isa);
+bool parse_isa(const std::string &name, Isa &isa);
+// cpuid based check, including OS support for the wider register files
+bool isa_supported(Isa isa);
+Isa detect_isa();
+
+// Vectorized escape-time kernels for the CPU path.
+//
+// Each kernel takes the coordinates of n pixels as two arrays (a chunk of a
+// view, see grid_kernel() in main.cpp) and writes one iteration count per
+// pixel, as Count: any of the count types of count_type() that holds the
+// iteration cap, so the lanes are narrowed as they are stored. The
+// arithmetic is done in exactly the same order as the scalar escape_time(),
+// so both produce identical counts for the same FractalParams, including
+// the mandelbrot cardioid / bulb test and the cycle detection. period (may
+// be null) receives the cycle length of interior points, 0 elsewhere.
+template <typename Count>
+using mandelbrot_kernel = KernelStats (*)(const double *cr, const double *ci, Count *bitmap, Count *period, int n, const FractalParams &params);
+
+// c is broadcast once to every lane, z0 comes from the coordinate arrays
+template <typename Count>
+using julia_kernel = KernelStats (*)(const double *xr, const double *xi, double cr, double ci, Count *bitmap, Count *period, int n, const FractalParams &params);
+
+template <typename Count>
+struct CpuKernels
+{
+    mandelbrot_kernel<Count> mandelbrot;
+    julia_kernel<Count> julia;
+    // float versions: twice the lanes, same results as escape_time<float>
+    mandelbrot_kernel<Count> mandelbrot_float;
+    julia_kernel<Count> julia_float;
+};
+
+// The kernels of sse4.2, avx2 or avx512, all null for the scalar isa. Count
+// is uint8_t, uint16_t or uint32_t.
+template <typename Count>
+CpuKernels<Count> simd_kernels(Isa isa);
@@ -0,0 +1,134 @@
+#include "subdivision.h"
+
+#include <vector>
+
+// the rectangles of one tile, split on the thread rendering it
+template <typename Count>
+struct Subdivision
+{
+    int width;
+    Count *bitmap;
+    Count *period;
+    const ComputePixels &compute;
+    TileStats stats;
+    std::vector<int> pixels;
+
+    void compute_listed()
+    {
+        if (!pixels.empty())
+        {
+            compute(pixels.data(), int(pixels.size()));
+            stats.computed += pixels.size();
+            pixels.clear();
+        }
+    }
+
+    void compute_row(int y, int x0, int x1)
+    {
+        for (int x = x0; x <= x1; x++)
+        {
+            pixels.push_back(width * y + x);
+        }
+    }
+
+    void compute_column(int x, int y0, int y1)
+    {
+        for (int y = y0; y <= y1; y++)
+        {
+            pixels.push_back(width * y + x);
+        }
+    }
+
+    // true if every border pixel of the rectangle has the count and period
+    // of its corner
+    bool uniform_border(int x0, int y0, int x1, int y1) const
+    {
+        int corner = width * y0 + x0;
+        auto same = [&](int i) { return bitmap[i] == bitmap[corner] && period[i] == period[corner]; };
+        for (int x = x0; x <= x1; x++)
+        {
+            if (!same(width * y0 + x) || !same(width * y1 + x))
+            {
+                return false;
+            }
+        }
+        for (int y = y0 + 1; y < y1; y++)
+        {
+            if (!same(width * y + x0) || !same(width * y + x1))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the border of the rectangle is done, its inside is not
+    void subdivide(int x0, int y0, int x1, int y1)
+    {
+        if (x1 - x0 < 2 || y1 - y0 < 2)
+        {
+            return;
+        }
+
+        if (uniform_border(x0, y0, x1, y1))
+        {
+            int corner = width * y0 + x0;
+            for (int y = y0 + 1; y < y1; y++)
+            {
+                for (int x = x0 + 1; x < x1; x++)
+                {
+                    bitmap[width * y + x] = bitmap[corner];
+                    period[width * y + x] = period[corner];
+                }
+            }
+            stats.filled += uint64_t(x1 - x0 - 1) * (y1 - y0 - 1);
+            return;
+        }
+
+        if (x1 - x0 <= SUBDIVISION_MIN_SIZE || y1 - y0 <= SUBDIVISION_MIN_SIZE)
+        {
+            for (int y = y0 + 1; y < y1; y++)
+            {
+                compute_row(y, x0 + 1, x1 - 1);
+            }
+            compute_listed();
+            return;
+        }
+
+        int mx = (x0 + x1) / 2;
+        int my = (y0 + y1) / 2;
+        compute_row(my, x0 + 1, x1 - 1);
+        compute_column(mx, y0 + 1, my - 1);
+        compute_column(mx, my + 1, y1 - 1);
+        compute_listed();
+
+        subdivide(x0, y0, mx, my);
+        subdivide(mx, y0, x1, my);
+        subdivide(x0, my, mx, y1);
+        subdivide(mx, my, x1, y1);
+    }
+};
+
+template <typename Count>
+TileStats subdivide_tile(int x0, int y0, int x1, int y1, int width, Count *bitmap, Count *period, const ComputePixels &compute)
+{
+    Subdivision<Count> s{width, bitmap, period, compute, {}, {}};
+    s.compute_row(y0, x0, x1);
+    if (y1 > y0)
+    {
+        s.compute_row(y1, x0, x1);
+    }
+    s.compute_column(x0, y0 + 1, y1 - 1);
+    if (x1 > x0)
+    {
+        s.compute_column(x1, y0 + 1, y1 - 1);
+    }
+    s.compute_listed();
+    s.subdivide(x0, y0, x1, y1);
+    return s.stats;
+}
+
+// subdivision for the uint8_t, uint16_t and uint32_t views
+template TileStats subdivide_tile(int, int, int, int, int, uint8_t *, uint8_t *, const ComputePixels &);
+template TileStats subdivide_tile(int, int, int, int, int, uint16_t *, uint16_t *, const ComputePixels &);
+template TileStats subdivide_tile(int, int, int, int, int, uint32_t *, uint32_t *, const ComputePixels &);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// Mariani-Silver rendering. The Mandelbrot set is connected, and so is every
+// region of iteration counts >= n around it, so a rectangle whose border has
+// one count (and one period) has it all the way through. Only the borders
+// are computed: uniform rectangles are filled, the others are split in four
+// along a middle row and column, which are computed in turn.
+
+// Callback that computes the n listed pixels (index y * width + x) into the
+// bitmap and period buffers the tile works on.
+using ComputePixels = std::function<void(const int *pixels, int n)>;
+
+struct TileStats
+{
+    uint64_t computed = 0;
+    uint64_t filled = 0;
+
+    TileStats &operator+=(const TileStats &other)
+    {
+        computed += other.computed;
+        filled += other.filled;
+        return *this;
+    }
+};
+
+// Rectangles this small are computed pixel by pixel instead of split
+constexpr int SUBDIVISION_MIN_SIZE = 6;
+
+// Renders the tile [x0, x1] x [y0, y1] (inclusive) of a grid width pixels
+// wide. Tiles share no pixels, so different tiles can run on different
+// threads. Count is the element type of the buffers: uint8_t, uint16_t or
+// uint32_t, see count_type().
+template <typename Count>
+TileStats subdivide_tile(int x0, int y0, int x1, int y1, int width, Count *bitmap, Count *period, const ComputePixels &compute);
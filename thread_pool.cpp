@@ -0,0 +1,179 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+
+static int64_t now_ns()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+ThreadPool::ThreadPool(unsigned thread_n) : slots(std::max(thread_n, 1u)), loads(slots.size())
+{
+    for (unsigned i = 1; i < slots.size(); i++)
+    {
+        workers.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+bool ThreadPool::pop_own(unsigned self, int &task)
+{
+    Slot &slot = slots[self];
+    std::lock_guard<std::mutex> lock(slot.mutex);
+    if (slot.tasks.empty())
+    {
+        return false;
+    }
+    task = slot.tasks.front();
+    slot.tasks.pop_front();
+    return true;
+}
+
+// Takes the last task of the next thread along that has any. The back holds
+// the work its owner would reach last.
+bool ThreadPool::steal(unsigned self, int &task)
+{
+    for (unsigned k = 1; k < slots.size(); k++)
+    {
+        Slot &victim = slots[(self + k) % slots.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run_tasks(unsigned self)
+{
+    Slot &slot = slots[self];
+    int task;
+    while (true)
+    {
+        bool own = pop_own(self, task);
+        if (!own && !steal(self, task))
+        {
+            // every deque is empty; tasks may still be running elsewhere
+            return;
+        }
+        if (job_generation.stale())
+        {
+            dropped = true;
+            continue;
+        }
+        int64_t start = now_ns();
+        int begin = task * job_grain;
+        (*body)(begin, std::min(begin + job_grain, job_n));
+        slot.busy_ns += now_ns() - start;
+        slot.task_n++;
+        slot.steals += !own;
+    }
+}
+
+void ThreadPool::worker_loop(unsigned self)
+{
+    uint64_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || job_serial != seen; });
+            if (stopping)
+            {
+                return;
+            }
+            seen = job_serial;
+            busy++;
+        }
+
+        run_tasks(self);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy--;
+        }
+        finished.notify_all();
+    }
+}
+
+bool ThreadPool::parallel_for(int n, int grain, const std::function<void(int, int)> &body, JobGeneration job)
+{
+    if (n <= 0)
+    {
+        return true;
+    }
+    int64_t start = now_ns();
+    grain = std::max(grain, 1);
+    int task_n = (n + grain - 1) / grain;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->body = &body;
+        job_n = n;
+        job_grain = grain;
+        job_generation = job;
+        dropped = false;
+        // contiguous shares, so neighbouring tasks stay on one thread
+        // unless they are stolen
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            Slot &slot = slots[i];
+            std::lock_guard<std::mutex> slot_lock(slot.mutex);
+            for (int task = int(i * task_n / slots.size()); task < int((i + 1) * task_n / slots.size()); task++)
+            {
+                slot.tasks.push_back(task);
+            }
+            slot.busy_ns = 0;
+            slot.task_n = 0;
+            slot.steals = 0;
+        }
+        job_serial++;
+    }
+    wake.notify_all();
+
+    run_tasks(0);
+
+    // wait for workers still inside a task; ones that never woke up for
+    // this job find every deque empty when they do
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return busy == 0; });
+    this->body = nullptr;
+
+    int64_t elapsed = now_ns() - start;
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        int64_t busy_ns = slots[i].busy_ns;
+        loads[i].busy_ns += busy_ns;
+        loads[i].idle_ns += std::max<int64_t>(elapsed - busy_ns, 0);
+        loads[i].tasks += slots[i].task_n;
+        loads[i].steals += slots[i].steals;
+    }
+    return !dropped;
+}
+
+void ThreadPool::reset_load()
+{
+    std::fill(loads.begin(), loads.end(), ThreadLoad{});
+}
+
+unsigned default_thread_count(unsigned fallback)
+{
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : fallback;
+}
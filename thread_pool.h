@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Time each thread spent in tasks and waiting for the rest of a parallel_for
+// to finish, summed over the calls since the last reset_load()
+struct ThreadLoad
+{
+    int64_t busy_ns = 0;
+    int64_t idle_ns = 0;
+    uint64_t tasks = 0;
+    // tasks taken from another thread's deque
+    uint64_t steals = 0;
+};
+
+// Generation a job was started for. The thread that starts jobs bumps
+// *latest whenever it wants a new one, which makes every job of an older
+// generation stale. A default JobGeneration is never stale.
+struct JobGeneration
+{
+    const std::atomic<uint64_t> *latest = nullptr;
+    uint64_t generation = 0;
+
+    bool stale() const { return latest && latest->load(std::memory_order_relaxed) != generation; }
+};
+
+// Fixed set of worker threads, started once and reused for every frame.
+//
+// parallel_for hands every thread a deque with an even share of the tasks.
+// Threads run their own tasks front to back and, once out of work, steal
+// from the back of another thread's deque, so a thread that got the slow
+// tasks around the set boundary is helped by the ones that finished early.
+class ThreadPool
+{
+public:
+    // thread_n counts the calling thread, which works along with the pool
+    // during parallel_for, so thread_n - 1 workers are started
+    explicit ThreadPool(unsigned thread_n);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const { return unsigned(slots.size()); }
+
+    // Calls body(begin, end) over [0, n) in tasks of at most grain, spread
+    // over all threads, and returns once every task is done. Once job turns
+    // stale the tasks not started yet are dropped; returns false if any
+    // were.
+    bool parallel_for(int n, int grain, const std::function<void(int, int)> &body, JobGeneration job = {});
+
+    // per thread, the calling thread first
+    std::vector<ThreadLoad> load() const { return std::vector<ThreadLoad>(loads); }
+    void reset_load();
+
+private:
+    // a thread's deque of task indices and what it did in the current job
+    struct alignas(64) Slot
+    {
+        std::mutex mutex;
+        std::deque<int> tasks;
+        std::atomic<int64_t> busy_ns{0};
+        std::atomic<uint64_t> task_n{0};
+        std::atomic<uint64_t> steals{0};
+    };
+
+    void worker_loop(unsigned self);
+    void run_tasks(unsigned self);
+    bool pop_own(unsigned self, int &task);
+    bool steal(unsigned self, int &task);
+
+    std::vector<Slot> slots;
+    std::vector<ThreadLoad> loads;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    // current job, guarded by mutex
+    const std::function<void(int, int)> *body = nullptr;
+    int job_n = 0;
+    int job_grain = 1;
+    JobGeneration job_generation;
+    std::atomic<bool> dropped{false};
+    // bumped for every parallel_for, to wake the workers
+    uint64_t job_serial = 0;
+    unsigned busy = 0;
+    bool stopping = false;
+};
+
+// Threads to use when none are given: one per hardware thread, fallback when
+// the standard library cannot tell
+unsigned default_thread_count(unsigned fallback);
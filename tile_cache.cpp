@@ -0,0 +1,60 @@
+#include "tile_cache.h"
+
+#include <functional>
+
+size_t TileKeyHash::operator()(const TileKey &key) const
+{
+    // boost::hash_combine
+    size_t h = 0;
+    auto combine = [&h](size_t value) { h ^= value + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2); };
+    combine(std::hash<int>()(key.level));
+    combine(std::hash<int64_t>()(key.tx));
+    combine(std::hash<int64_t>()(key.ty));
+    combine(std::hash<uint32_t>()(key.max_iteration));
+    combine(size_t(key.formula));
+    combine(size_t(key.precision));
+    return h;
+}
+
+TileCache::TileCache(size_t budget_bytes) : budget_bytes(budget_bytes) {}
+
+size_t TileCache::tile_bytes(const CachedTile &tile)
+{
+    return tile.bitmap.size() + tile.period.size() + tile.valid.size();
+}
+
+CachedTile *TileCache::find(const TileKey &key)
+{
+    auto it = index.find(key);
+    if (it == index.end())
+    {
+        return nullptr;
+    }
+    tiles.splice(tiles.begin(), tiles, it->second);
+    return &it->second->second;
+}
+
+void TileCache::insert(const TileKey &key, CachedTile tile)
+{
+    auto it = index.find(key);
+    if (it != index.end())
+    {
+        used_bytes -= tile_bytes(it->second->second);
+        tiles.erase(it->second);
+        index.erase(it);
+    }
+    size_t bytes = tile_bytes(tile);
+    if (bytes > budget_bytes)
+    {
+        return;
+    }
+    while (used_bytes + bytes > budget_bytes)
+    {
+        used_bytes -= tile_bytes(tiles.back().second);
+        index.erase(tiles.back().first);
+        tiles.pop_back();
+    }
+    tiles.emplace_front(key, std::move(tile));
+    index[key] = tiles.begin();
+    used_bytes += bytes;
+}
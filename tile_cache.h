@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "fractal.h"
+
+// Rendered tiles of past views, in the style of web map tiles. A tile is
+// size x size pixels at one zoom level, and tile (tx, ty) holds the pixels
+// (tx * size + x, ty * size + y) of the level's pixel lattice, so a view
+// aligned to the lattice finds the tiles of every view it overlaps at that
+// level. The least recently used tiles are dropped once the memory budget
+// is exceeded.
+struct TileKey
+{
+    int level;
+    int64_t tx;
+    int64_t ty;
+    uint32_t max_iteration;
+    Formula formula;
+    // tiles are only reused in the arithmetic they were computed in
+    Precision precision;
+};
+
+inline bool operator==(const TileKey &a, const TileKey &b)
+{
+    return a.level == b.level && a.tx == b.tx && a.ty == b.ty && a.max_iteration == b.max_iteration && a.formula == b.formula && a.precision == b.precision;
+}
+
+struct TileKeyHash
+{
+    size_t operator()(const TileKey &key) const;
+};
+
+// Counts and periods of a tile, row-major. Tiles at the edge of a view are
+// kept too, with only the pixels in view marked valid; later views fill in
+// the rest. The counts are stored in the type of the key's iteration cap,
+// see count_type(), as raw bytes.
+struct CachedTile
+{
+    std::vector<uint8_t> bitmap;
+    std::vector<uint8_t> period;
+    std::vector<uint8_t> valid;
+    int valid_n = 0;
+
+    template <typename Count>
+    Count *counts()
+    {
+        return reinterpret_cast<Count *>(bitmap.data());
+    }
+    template <typename Count>
+    const Count *counts() const
+    {
+        return reinterpret_cast<const Count *>(bitmap.data());
+    }
+    template <typename Count>
+    Count *periods()
+    {
+        return reinterpret_cast<Count *>(period.data());
+    }
+    template <typename Count>
+    const Count *periods() const
+    {
+        return reinterpret_cast<const Count *>(period.data());
+    }
+};
+
+class TileCache
+{
+public:
+    explicit TileCache(size_t budget_bytes);
+
+    size_t budget() const { return budget_bytes; }
+    size_t bytes() const { return used_bytes; }
+    size_t size() const { return tiles.size(); }
+
+    // The tile, made the most recently used, or nullptr. The pointer stays
+    // valid until the next insert().
+    CachedTile *find(const TileKey &key);
+    // Adds or replaces a tile, evicting the least recently used ones that do
+    // not fit the budget. Tiles bigger than the whole budget are not kept.
+    void insert(const TileKey &key, CachedTile tile);
+
+private:
+    using Entry = std::pair<TileKey, CachedTile>;
+
+    static size_t tile_bytes(const CachedTile &tile);
+
+    size_t budget_bytes;
+    size_t used_bytes = 0;
+    // most recently used first
+    std::list<Entry> tiles;
+    std::unordered_map<TileKey, std::list<Entry>::iterator, TileKeyHash> index;
+};